@@ -0,0 +1,179 @@
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP
+
+// General headers
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Posit name, e.g. "posit<16,1>"
+template <typename Posit>
+std::string posit_name() {
+	return "posit<" + std::to_string(Posit::nbits) + "," + std::to_string(Posit::es) + ">";
+}
+
+// Shape as "64x1x28x28"
+inline std::string shape_name(std::vector<size_t> const& shape) {
+	std::string name;
+
+	for(size_t i=0; i<shape.size(); i++) {
+		if(i > 0)
+			name += "x";
+		name += std::to_string(shape[i]);
+	}
+
+	return name;
+}
+
+struct BenchmarkResult {
+	std::string kernel;
+	std::string posit;
+	std::string shape;
+	size_t elements;	// # of output elements
+	double ops;			// # of operations (multiply-add counts as 2)
+	size_t runs;
+	double ns;			// median time of one run
+
+	std::string id() const {
+		return kernel + "/" + posit + "/" + shape;
+	}
+};
+
+// Times kernels and writes the results as JSON
+// Scaling is computed against a baseline file (results with 1 thread)
+class Benchmark {
+public:
+	Benchmark(int argc, char* argv[]) {
+		for(int i=1; i<argc; i++) {
+			std::string const arg = argv[i];
+
+			if(arg=="--time" && i+1<argc)
+				min_time = std::stod(argv[++i]);
+			else if(arg=="--filter" && i+1<argc)
+				filter = argv[++i];
+			else if(arg=="--baseline" && i+1<argc)
+				read_baseline(argv[++i]);
+			else if(arg=="--output" && i+1<argc)
+				output = argv[++i];
+			else {
+				std::cerr << "Usage: " << argv[0] << " [--time seconds] [--filter text] "
+						  << "[--baseline file.json] [--output file.json]" << std::endl;
+				std::exit(1);
+			}
+		}
+	}
+
+	// Run kernel until it takes at least min_time (and min_runs) and save median
+	template <typename Function>
+	void run(	std::string const& kernel, std::string const& posit, std::string const& shape,
+				size_t const elements, double const ops, Function function	){
+
+		BenchmarkResult result = {kernel, posit, shape, elements, ops, 0, 0};
+
+		if(result.id().find(filter) == std::string::npos)
+			return;
+
+		// Warm up (also initializes windows and allocations)
+		function();
+
+		std::vector<double> times;
+		double total = 0;
+
+		while(total < min_time || times.size() < min_runs) {
+			auto const start = std::chrono::steady_clock::now();
+			function();
+			auto const end = std::chrono::steady_clock::now();
+
+			times.push_back(std::chrono::duration<double, std::nano>(end-start).count());
+			total += times.back() * 1e-9;
+		}
+
+		std::sort(times.begin(), times.end());
+		result.runs = times.size();
+		result.ns = times[times.size()/2];
+		results.push_back(result);
+
+		std::cerr << result.id() << ": " << result.ns*1e-6 << " ms" << std::endl;
+	}
+
+	// Write JSON (one result per line)
+	void write(size_t const threads, int const quire_mode) const {
+		std::ofstream file;
+		if(!output.empty())
+			file.open(output);
+		std::ostream& out = output.empty() ? std::cout : file;
+
+		out << "{" << std::endl;
+		out << "\"threads\": " << threads << "," << std::endl;
+		out << "\"quire_mode\": " << quire_mode << "," << std::endl;
+		out << "\"results\": [" << std::endl;
+
+		for(size_t i=0; i<results.size(); i++) {
+			BenchmarkResult const& r = results[i];
+			double const ns_per_element = r.ns / r.elements;
+			double const gops = r.ops / r.ns;
+
+			out << "{\"id\": \"" << r.id() << "\", "
+				<< "\"kernel\": \"" << r.kernel << "\", "
+				<< "\"posit\": \"" << r.posit << "\", "
+				<< "\"shape\": \"" << r.shape << "\", "
+				<< "\"elements\": " << r.elements << ", "
+				<< "\"runs\": " << r.runs << ", "
+				<< "\"ns\": " << r.ns << ", "
+				<< "\"ns_per_element\": " << ns_per_element << ", "
+				<< "\"gops\": " << gops;
+
+			auto const it = baseline.find(r.id());
+			if(it != baseline.end()) {
+				double const speedup = it->second / r.ns;
+				out << ", \"speedup\": " << speedup
+					<< ", \"efficiency\": " << speedup / threads;
+			}
+
+			out << "}" << (i+1<results.size() ? "," : "") << std::endl;
+		}
+
+		out << "]" << std::endl;
+		out << "}" << std::endl;
+	}
+
+private:
+	// Read times of a file written by write()
+	void read_baseline(std::string const& filename) {
+		std::ifstream file(filename);
+
+		if(!file) {
+			std::cerr << "Error in opening file: " << filename << std::endl;
+			return;
+		}
+
+		std::string line;
+		while(std::getline(file, line)) {
+			size_t const id = line.find("\"id\": \"");
+			size_t const ns = line.find("\"ns\": ");
+
+			if(id==std::string::npos || ns==std::string::npos)
+				continue;
+
+			size_t const id_begin = id + 7;
+			size_t const id_end = line.find('"', id_begin);
+			baseline[line.substr(id_begin, id_end-id_begin)] = std::stod(line.substr(ns + 6));
+		}
+	}
+
+	double min_time = 0.2;	// seconds per kernel
+	size_t const min_runs = 3;
+	std::string filter;
+	std::string output;
+	std::map<std::string, double> baseline;
+	std::vector<BenchmarkResult> results;
+};
+
+#endif /* BENCHMARK_HPP */
@@ -0,0 +1,154 @@
+// General headers
+#include <iostream>
+#include <universal/posit/posit>
+#include <positnn/positnn>
+#include <vector>
+
+// Custom headers
+#include "benchmark.hpp"
+
+// Shapes of layers of LeNet-5 and CifarNet (batch of 64) and larger ones
+struct LinearShape { size_t batch, in, out; };
+struct ConvShape { size_t batch, in_channels, height, width, out_channels, kernel_size, padding; };
+struct PoolShape { size_t batch, channels, height, width, kernel_size; };
+
+std::vector<LinearShape> const linear_shapes = {
+	{64, 400, 120}, {64, 120, 84}, {64, 84, 10},	// LeNet-5
+	{64, 1024, 384}, {64, 384, 192},				// CifarNet
+	{64, 1024, 512}
+};
+
+std::vector<ConvShape> const conv_shapes = {
+	{64, 1, 28, 28, 6, 5, 2}, {64, 6, 14, 14, 16, 5, 0},	// LeNet-5
+	{64, 3, 32, 32, 8, 5, 0}, {64, 8, 14, 14, 16, 5, 0},	// CifarNet
+	{16, 32, 16, 16, 32, 3, 1}
+};
+
+std::vector<PoolShape> const pool_shapes = {
+	{64, 6, 28, 28, 2}, {64, 16, 10, 10, 2},	// LeNet-5
+	{64, 8, 28, 28, 2},							// CifarNet
+	{32, 32, 32, 32, 2}
+};
+
+std::vector<size_t> const vector_sizes = {48000, 393216, 1048576};
+
+template <typename Posit>
+StdTensor<Posit> random_tensor(std::vector<size_t> const& shape) {
+	StdTensor<Posit> tensor(shape);
+	set_uniform<Posit>(tensor, -1, 1);
+	return tensor;
+}
+
+template <typename Posit>
+void benchmark_posit(Benchmark& benchmark) {
+	std::string const name = posit_name<Posit>();
+
+	// Linear layer (forward, backward and weight gradient are all matmul_row)
+	for(LinearShape const& s : linear_shapes) {
+		StdTensor<Posit> const input = random_tensor<Posit>({s.batch, s.in});
+		StdTensor<Posit> const weight = random_tensor<Posit>({s.out, s.in});
+		StdTensor<Posit> const bias = random_tensor<Posit>({s.out});
+		std::string const shape = shape_name({s.batch, s.in}) + "*" + shape_name({s.out, s.in});
+		size_t const elements = s.batch*s.out;
+		double const ops = 2.0*s.batch*s.out*s.in;
+
+		benchmark.run("matmul_row", name, shape, elements, ops,
+				[&](){ matmul_row(input, weight); });
+		benchmark.run("matmul_row_add", name, shape, elements, ops,
+				[&](){ matmul_row_add(input, weight, bias); });
+	}
+
+	// Convolution (forward, weight gradient and input gradient)
+	for(ConvShape const& s : conv_shapes) {
+		StdTensor<Posit> const input = random_tensor<Posit>({s.batch, s.in_channels, s.height, s.width});
+		StdTensor<Posit> const weight = random_tensor<Posit>({s.out_channels, s.in_channels, s.kernel_size, s.kernel_size});
+		StdTensor<Posit> const bias = random_tensor<Posit>({s.out_channels});
+		std::string const shape = shape_name(input.shape()) + "*" + shape_name(weight.shape())
+								+ "p" + std::to_string(s.padding);
+
+		StdTensor<Posit> const output = convolution2d(input, weight, bias, 1, s.padding);
+		StdTensor<Posit> const delta = random_tensor<Posit>(output.shape());
+		double const ops = 2.0*output.size()*s.in_channels*s.kernel_size*s.kernel_size;
+
+		benchmark.run("convolution2d", name, shape, output.size(), ops,
+				[&](){ convolution2d(input, weight, bias, 1, s.padding); });
+
+		std::vector<uint8_t> max_offset;
+		benchmark.run("convolution2d_maximumpool2d_relu", name, shape, output.size()/4, ops,
+				[&](){ convolution2d_maximumpool2d_relu(input, weight, bias, 1, s.padding, 1, 2, 2, 0,
+														&max_offset); });
+
+		benchmark.run("convolution2d_gradient", name, shape, weight.size(), ops,
+				[&](){ convolution2d_gradient(input, delta, 1, s.padding); });
+		benchmark.run("convolution2d_input_gradient", name, shape, input.size(), ops,
+				[&](){ convolution2d_input_gradient(delta, weight, s.height, s.width, 1, s.padding, 1); });
+
+		benchmark.run("sum_last2", name, shape_name(delta.shape()), delta.size()/output.shape()[2]/output.shape()[3], delta.size(),
+				[&](){ sum_last2(delta); });
+
+		// Same with channels last
+		StdTensor<Posit> const input_last = to_channels_last(input);
+		StdTensor<Posit> const delta_last = to_channels_last(delta);
+
+		benchmark.run("convolution2d_channels_last", name, shape, output.size(), ops,
+				[&](){ convolution2d_channels_last(input_last, weight, bias, 1, s.padding); });
+		benchmark.run("convolution2d_gradient_channels_last", name, shape, weight.size(), ops,
+				[&](){ convolution2d_gradient_channels_last(input_last, delta_last, 1, s.padding); });
+		benchmark.run("convolution2d_input_gradient_channels_last", name, shape, input.size(), ops,
+				[&](){ convolution2d_input_gradient_channels_last(delta_last, weight, s.height, s.width, 1, s.padding, 1); });
+	}
+
+	// Max pooling (forward and backward)
+	for(PoolShape const& s : pool_shapes) {
+		StdTensor<Posit> const input = random_tensor<Posit>({s.batch, s.channels, s.height, s.width});
+		std::string const shape = shape_name(input.shape()) + "k" + std::to_string(s.kernel_size);
+
+		Window const& window = pool2d_window(input.shape(), s.kernel_size, s.kernel_size, 0);
+		std::vector<uint8_t> max_offset;
+		StdTensor<Posit> const output = maximumpool2d(input, s.kernel_size, s.kernel_size, 0, &max_offset, &window);
+		double const ops = 1.0*output.size()*s.kernel_size*s.kernel_size;
+
+		benchmark.run("maximumpool2d", name, shape, output.size(), ops,
+				[&](){ maximumpool2d(input, s.kernel_size, s.kernel_size, 0, &max_offset, &window); });
+		benchmark.run("maximumpool2d_backward", name, shape, input.size(), output.size(),
+				[&](){ maximumpool2d_backward(output, input.shape(), s.kernel_size, s.kernel_size, max_offset, window); });
+
+		StdTensor<Posit> const input_last = to_channels_last(input);
+		benchmark.run("maximumpool2d_channels_last", name, shape, output.size(), ops,
+				[&](){ maximumpool2d_channels_last(input_last, s.kernel_size, s.kernel_size, 0, &max_offset, &window); });
+	}
+
+	// Element-wise kernels
+	for(size_t const size : vector_sizes) {
+		StdTensor<Posit> a = random_tensor<Posit>({size});
+		StdTensor<Posit> const b = random_tensor<Posit>({size});
+		StdTensor<Posit> const matrix = random_tensor<Posit>({64, size/64});
+		StdTensor<float> const b_float(b);
+		std::string const shape = shape_name({size});
+
+		benchmark.run("sum_first", name, shape_name(matrix.shape()), matrix.shape()[1], size,
+				[&](){ sum_first(matrix); });
+		benchmark.run("fused", name, shape, size, 2.0*size,
+				[&](){ fused(a, b, Posit(0.5), Posit(0.25)); });
+		benchmark.run("convert_to_posit<8,2>", name, shape, size, size,
+				[&](){ StdTensor<posit<8, 2>> c(b); });
+		benchmark.run("convert_from_float", name, shape, size, size,
+				[&](){ StdTensor<Posit> c(b_float); });
+	}
+}
+
+int main(int argc, char* argv[]) {
+	Benchmark benchmark(argc, argv);
+
+	std::cerr << "Threads: " << LL_THREADS << std::endl;
+	std::cerr << "Quire mode: " << QUIRE_MODE << std::endl;
+
+	benchmark_posit<posit<8, 2>>(benchmark);
+	benchmark_posit<posit<12, 1>>(benchmark);
+	benchmark_posit<posit<16, 1>>(benchmark);
+	benchmark_posit<posit<32, 2>>(benchmark);
+
+	benchmark.write(LL_THREADS, QUIRE_MODE);
+
+	return 0;
+}
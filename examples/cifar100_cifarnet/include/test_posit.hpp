@@ -6,8 +6,9 @@
 
 template <typename Type, template<typename> class Model, typename DataLoader>
 void test_posit(Model<Type>& model, DataLoader& data_loader, size_t dataset_size) {
-	// Setup inference
+	// Setup inference (without keeping what backward needs)
 	model.eval();
+	NoGradGuard no_grad;
 	float test_loss = 0;
 	size_t correct = 0;
 	size_t correct_top5 = 0;
@@ -36,7 +37,7 @@ void test_posit(Model<Type>& model, DataLoader& data_loader, size_t dataset_size
 		
 		// Calculate loss
 		test_loss += cross_entropy_loss<L>(output, target,
-						Reduction::Sum).template item<float>();
+						Reduction::Sum, false).template item<float>();
 		
 		// Get prediction from output
 		auto pred = output.template argmax<T>(1);
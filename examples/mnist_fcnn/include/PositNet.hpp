@@ -5,38 +5,17 @@
 #include <positnn/positnn>
 
 template <typename T>
-class PositNet : public Layer<T>{
+class PositNet : public Sequential<T>{
 public:
-	PositNet() :
-		linear1(784, 32),
-		linear2(32, 10)
-	{
-		this->register_module(linear1);
-		this->register_module(linear2);
-	}
-
-	StdTensor<T> forward(StdTensor<T> x) {
+	PositNet() {
 		// Flatten data
-		x.reshape({x.shape()[0], 784});
+		this->template add<Flatten>();
 
-		x = linear1.forward(x);
-		x = relu.forward(x);
+		// Linear with ReLU
+		this->template add<Linear<T>>(784, 32, Activation::relu);
 
-		x = linear2.forward(x);
-		return x;
+		this->template add<Linear<T>>(32, 10);
 	}
-
-	StdTensor<T> backward(StdTensor<T> x) {
-		x = linear2.backward(x);
-		
-		x = relu.backward(x);
-		x = linear1.backward(x);
-		return x;
-	}
-
-private:
-	Linear<T> linear1, linear2;
-	ReLU relu;
 };
 
 #endif /* NET_HPP */
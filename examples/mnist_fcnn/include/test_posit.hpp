@@ -15,6 +15,7 @@ void test_posit(	Model<Posit>& model,
 	using Target = unsigned short int;
 
 	model.eval();
+	NoGradGuard no_grad;
 	float test_loss = 0;
 	size_t correct = 0;
 
@@ -36,7 +37,7 @@ void test_posit(	Model<Posit>& model,
 		
 		// Calculate loss
 		test_loss += cross_entropy_loss<Posit>(output,target,
-						Reduction::Sum).template item<float>();
+						Reduction::Sum, false).template item<float>();
 
 		// Get prediction from output
 		auto pred = output.template argmax<Target>(1);
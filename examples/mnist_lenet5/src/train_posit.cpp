@@ -46,14 +46,15 @@ struct Type{
 #define SAVE_EPOCH true
 
 template<typename T, template<typename> class ModelPosit>
-void save_model(std::string save_path, ModelPosit<T>& model_posit, size_t const epoch) {
+void save_model(Checkpointer& checkpointer, std::string save_path, ModelPosit<T>& model_posit, size_t const epoch) {
 	// Posit
 	char net_epoch_filename_posit[128];
 	snprintf(net_epoch_filename_posit, sizeof(net_epoch_filename_posit),
 			NET_EPOCH_FILENAME_POSIT, epoch);
 	save_path += net_epoch_filename_posit;
 
-	save<typename T::SaveFile>(model_posit, save_path);
+	// Written in background while training continues
+	checkpointer.save<typename T::SaveFile>(model_posit, save_path);
 }
 	
 int main() {
@@ -106,9 +107,12 @@ int main() {
 	if(COPY)
 		copy_parameters(model_float->parameters(), model_posit.parameters());
 
+	// Saves models in background (waits for pending files when it goes out of scope)
+	Checkpointer checkpointer;
+
 	// Save net before training
 	if(SAVE_UNTRAINED)
-		save_model(NET_SAVE_PATH, model_posit, 0);
+		save_model(checkpointer, NET_SAVE_PATH, model_posit, 0);
 
 	// Load MNIST training dataset
 	auto train_dataset = torch::data::datasets::MNIST(DATASET_PATH)
@@ -144,13 +148,22 @@ int main() {
 
     // Train the model
     std::cout << std::endl << "Running..." << std::endl;
+#ifdef USING_PROFILE_SCOPES
+	Profiler::instance().clear();
+	Profiler::instance().trace();
+#endif /* USING_PROFILE_SCOPES */
     for (size_t epoch = 1; epoch<=num_epochs; ++epoch) {
 		train_posit(epoch, num_epochs, model_posit, *train_loader, optimizer_posit, kLogInterval, train_dataset_size);
 		test_posit(model_posit, *test_loader, test_dataset_size);
+
+#ifdef USING_PROFILE_SCOPES
+		// Time and operations of each layer in this epoch
+		Profiler::instance().print();
+#endif /* USING_PROFILE_SCOPES */
 		
 		// Save models after each epoch
 		if(SAVE_EPOCH)
-			save_model(NET_SAVE_PATH, model_posit, epoch);
+			save_model(checkpointer, NET_SAVE_PATH, model_posit, epoch);
 		
 		// Update learning rate every adaptive_lr epochs
 		if(adaptive_lr>0 && epoch%adaptive_lr==0) {
@@ -160,6 +173,10 @@ int main() {
 		}
     }
 
+#ifdef USING_PROFILE_SCOPES
+	Profiler::instance().write_trace(std::string(NET_SAVE_PATH) + "trace.json");
+#endif /* USING_PROFILE_SCOPES */
+
     std::cout << "Finished!\n";
 
 	return 0;
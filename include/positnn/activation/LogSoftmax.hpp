@@ -2,67 +2,97 @@
 #define LOGSOFTMAX_HPP
 
 // General headers
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
+#include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
 template <typename Posit>
-class LogSoftmax {
+class LogSoftmax : public BackwardState {
 public:	
 	LogSoftmax() { }
 
 	StdTensor<Posit> forward(StdTensor<Posit>& x) {
+		PROFILE_SCOPE("forward", x);
 		//TODO: protect for tensors with dim!=2
 		const size_t batch_size = x.shape()[0];
 		const size_t sample_size = x.shape()[1];
 
-		exp_x_max = StdTensor<Posit>({batch_size, sample_size});
-		sum_exp = StdTensor<Posit>(batch_size);
+		// Keep exp(x-max) and its sum for backward
+		// Without saving, clear them, so backward can't use those of a previous forward
+		bool const save = save_for_backward();
+		if(save) {
+			exp_x_max = StdTensor<Posit>({batch_size, sample_size});
+			sum_exp = StdTensor<Posit>(batch_size);
+		}
+		else {
+			exp_x_max = StdTensor<Posit>();
+			sum_exp = StdTensor<Posit>();
+		}
 
 		StdTensor<Posit> output = StdTensor<Posit>(x);
-		Posit max, delta;
+		Posit max, sum, delta;
 
 		Quire<Posit::nbits, Posit::es> q;
 
 		typename StdTensor<Posit>::iterator const x_begin = x.begin();
 
 		for(size_t i=0, j=0; i<batch_size; i++, j+=sample_size) {
-			max = *std::max_element(x_begin+j, x_begin+j+sample_size);
+			max = *std::max_element(x_begin+j, x_begin+j+sample_size, OrdinalLess());
 
 			q.clear();
 			for(size_t k=0; k<sample_size; k++) {
-				exp_x_max[j+k] = exp(x[j+k] - max);
-				q += exp_x_max[j+k];
+				Posit const exp_x = exp(x[j+k] - max);
+				q += exp_x;
+
+				if(save)
+					exp_x_max[j+k] = exp_x;
 			}
 
-			convert(q.to_value(), sum_exp[i]);
+			convert(q.to_value(), sum);
+
+			if(save)
+				sum_exp[i] = sum;
 
-			delta = max + log(sum_exp[i]);
+			delta = max + log(sum);
 
 			for(size_t k=0; k<sample_size; k++)
 				output[j+k] -= delta;
 		}
 
+		COUNT_OPS(Posit, OP_EXP_LOG, x.size() + batch_size);
+
+		PROFILE_OUTPUT(output);
 		return output;
 	}
 
 	StdTensor<Posit> backward(StdTensor<Posit>& w_delta) {
 	//TODO: BACKWARD IS INCORRECT. SHOULD USE JACOBIAN INSTEAD OF HADAMARD PRODUCT
+		PROFILE_SCOPE("backward", w_delta);
+		if(exp_x_max.size() != w_delta.size())
+			throw std::logic_error( "backward of LogSoftmax needs a forward in training with gradient enabled" );
+
 		StdTensor<Posit> deltaN = derivative();
 		deltaN *= w_delta;
+		PROFILE_OUTPUT(deltaN);
 		return deltaN;
 	}
 
 	StdTensor<Posit> derivative() const {
+		if(exp_x_max.dim() != 2)
+			throw std::logic_error( "derivative of LogSoftmax needs a forward in training with gradient enabled" );
+
 		const size_t batch_size = exp_x_max.shape()[0];
 		const size_t sample_size = exp_x_max.shape()[1];
 
-		// TODO: protect against initialized output
 		StdTensor<Posit> dx({batch_size, sample_size});
 
 		for(size_t i=0, j=0; i<batch_size; i++, j+=sample_size) {
@@ -77,6 +107,7 @@ public:
 private:
 	StdTensor<Posit> sum_exp;
 	StdTensor<Posit> exp_x_max;
+	PROFILE_NAME("LogSoftmax")
 };
 
 #endif /* LOGSOFTMAX_HPP */
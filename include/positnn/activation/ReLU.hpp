@@ -2,48 +2,87 @@
 #define RELU_HPP
 
 // General headers
+#include <cstdint>
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
+#include "../tensor/BitMask.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
+#include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
-class ReLU {
+class ReLU : public BackwardState {
 public:	
 	ReLU() { }
 
 	template <typename T>
 	StdTensor<T> forward(StdTensor<T> x) {
-		zero.resize(x.size());
+		PROFILE_SCOPE("forward", x);
+		size_t const size = x.size();
 
-		for(size_t i=0, size=x.size(); i<size; i++) {
-			if(x[i].isneg() || x[i].iszero()) {
-				x[i].setzero();
-				zero[i] = true;
+		// Without saving, clear the mask of a previous forward, so backward can't use it
+		if(!save_for_backward()) {
+			zero.resize(0);
+
+			for(size_t i=0; i<size; i++) {
+				if(is_nonpositive(x[i]))
+					x[i].setzero();
 			}
-			else {
-				zero[i] = false;
+
+			PROFILE_OUTPUT(x);
+			return x;
+		}
+
+		zero.resize(size);
+
+		// Build the mask one word at a time
+		for(size_t w=0, n_words=zero.n_words(); w<n_words; w++) {
+			size_t const begin = w*BitMask::word_bits;
+			size_t const end = (begin+BitMask::word_bits < size) ? begin+BitMask::word_bits : size;
+			uint64_t bits = 0;
+
+			for(size_t i=begin; i<end; i++) {
+				if(is_nonpositive(x[i])) {
+					x[i].setzero();
+					bits |= uint64_t(1) << (i-begin);
+				}
 			}
+
+			zero.set_word(w, bits);
 		}
 
+		PROFILE_OUTPUT(x);
 		return x;
 	}
 
 	template <typename T>
 	StdTensor<T> backward(StdTensor<T> delta) {
-		for(size_t i=0, size=delta.size(); i<size; i++){
-			if(zero[i]) {
-				delta[i].setzero();
+		PROFILE_SCOPE("backward", delta);
+		if(zero.size() != delta.size())
+			throw std::logic_error( "backward of ReLU needs a forward in training with gradient enabled" );
+
+		// Only visit the zeroed entries of each word
+		for(size_t w=0, n_words=zero.n_words(); w<n_words; w++) {
+			uint64_t bits = zero.word(w);
+
+			for(size_t i=w*BitMask::word_bits; bits!=0; bits>>=1, i++) {
+				if(bits & 1)
+					delta[i].setzero();
 			}
 		}
 
+		PROFILE_OUTPUT(delta);
 		return delta;
 	}
 
 private:
-	std::vector<bool> zero;
+	BitMask zero;
+	PROFILE_NAME("ReLU")
 };
 
 #endif /* RELU_HPP */
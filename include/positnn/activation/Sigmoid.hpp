@@ -2,43 +2,61 @@
 #define SIGMOID_HPP
 
 // General headers
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
 #include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
 template <typename ForwardT, typename BackwardT=ForwardT>
-class Sigmoid {
+class Sigmoid : public BackwardState {
 public:	
 	Sigmoid() { }
 
 	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x, bool approximate=true) {
+		PROFILE_SCOPE("forward", x);
 		StdTensor<ForwardT> y(x.shape());
 
 		for(size_t i=0, size=x.size(); i<size; i++) {
 			if(approximate && ForwardT::es==0)
 				y[i] = sigmoid_approx(x[i]);
-			else
+			else {
 				y[i] = 1/(1+exp(-x[i]));
+				COUNT_OPS(ForwardT, OP_EXP_LOG, 1);
+			}
 		}
 
-		output = y;
+		// Without saving, clear the output of a previous forward, so backward can't use it
+		if(save_for_backward())
+			output = y;
+		else
+			output = StdTensor<BackwardT>();
 
+		PROFILE_OUTPUT(y);
 		return y;
 	}
 
 	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& w_delta) {
+		PROFILE_SCOPE("backward", w_delta);
+		if(output.size() != w_delta.size())
+			throw std::logic_error( "backward of Sigmoid needs a forward in training with gradient enabled" );
+
 		StdTensor<BackwardT> deltaN = derivative();
 		deltaN *= w_delta;
+		PROFILE_OUTPUT(deltaN);
 		return deltaN;
 	}
 
 	StdTensor<BackwardT> derivative() const {
-		// TODO: protect against initialized output
+		if(output.empty())
+			throw std::logic_error( "derivative of Sigmoid needs a forward in training with gradient enabled" );
+
 		StdTensor<BackwardT> dx(output.shape());
 
 		BackwardT pOne(1);
@@ -47,12 +65,15 @@ public:
 			convert( fam_corrected(pOne, -output[i], output[i]) ,
 					 dx[i] );
 		}
+
+		COUNT_OPS(BackwardT, OP_FUSED, dx.size());
 		
 		return dx;
 	}
 
 private:
 	StdTensor<BackwardT> output;
+	PROFILE_NAME("Sigmoid")
 };
 
 #endif /* SIGMOID_HPP */
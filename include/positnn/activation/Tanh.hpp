@@ -2,21 +2,25 @@
 #define TANH_HPP
 
 // General headers
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
 #include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
 template <typename ForwardT, typename BackwardT=ForwardT>
-class Tanh {
+class Tanh : public BackwardState {
 public:	
 	Tanh() { }
 
 	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x, bool approximate=true) {
+		PROFILE_SCOPE("forward", x);
 		StdTensor<ForwardT> y(x.shape());
 		
 		for(size_t i=0, size=x.size(); i<size; i++) {
@@ -27,22 +31,35 @@ public:
 				ForwardT plus = exp(x[i]);
 				ForwardT minus = exp(-x[i]);
 				y[i] = (plus-minus)/(plus+minus);
+				COUNT_OPS(ForwardT, OP_EXP_LOG, 2);
 			}
 		}
 
-		output = y;
+		// Without saving, clear the output of a previous forward, so backward can't use it
+		if(save_for_backward())
+			output = y;
+		else
+			output = StdTensor<BackwardT>();
 
+		PROFILE_OUTPUT(y);
 		return y;
 	}
 
 	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& w_delta) {
+		PROFILE_SCOPE("backward", w_delta);
+		if(output.size() != w_delta.size())
+			throw std::logic_error( "backward of Tanh needs a forward in training with gradient enabled" );
+
 		StdTensor<BackwardT> deltaN = derivative();
 		deltaN *= w_delta;
+		PROFILE_OUTPUT(deltaN);
 		return deltaN;
 	}
 
 	StdTensor<BackwardT> derivative() const {
-		// TODO: protect against initialized output
+		if(output.empty())
+			throw std::logic_error( "derivative of Tanh needs a forward in training with gradient enabled" );
+
 		StdTensor<BackwardT> dx(output.shape());
 
 		BackwardT pOne(1);
@@ -51,12 +68,15 @@ public:
 			convert( fma(output[i], -output[i], pOne) ,
 					 dx[i] );
 		}
+
+		COUNT_OPS(BackwardT, OP_FUSED, dx.size());
 		
 		return dx;
 	}
 
 private:
 	StdTensor<BackwardT> output;
+	PROFILE_NAME("Tanh")
 };
 
 #endif /* TANH_HPP */
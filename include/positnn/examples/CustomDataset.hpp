@@ -2,6 +2,7 @@
 #define CUSTOMDATASET_HPP
 
 // General headers
+#include <positnn/positnn>
 #include <torch/torch.h>
 
 class CustomDataset : public torch::data::Dataset<CustomDataset> {
@@ -24,6 +25,20 @@ public:
 			y[i] = torch::full({1}, y_data[i]);
 	}
 
+	// Constructor from tensors with shape {samples, values} (see load_data)
+	// Data is copied once and each sample is a view of it
+	CustomDataset(StdTensor<float>& x_data, StdTensor<float>& y_data) {
+		long long const n = x_data.shape()[0];
+
+		torch::Tensor const x_all = torch::from_blob(x_data.vector().data(),
+								{n, static_cast<long long>(x_data.shape()[1])}).clone();
+		torch::Tensor const y_all = torch::from_blob(y_data.vector().data(),
+								{n, static_cast<long long>(y_data.shape()[1])}).clone();
+
+		x = x_all.unbind(0);
+		y = y_all.unbind(0);
+	}
+
 	// Override get() function to return tensor at location index
 	torch::data::Example<> get(size_t index) override {
 		torch::Tensor sample_x = x.at(index);
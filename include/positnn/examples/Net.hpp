@@ -12,6 +12,7 @@ public:
 		linear2(hidden, out)
 	{
 		this->register_module(linear1);
+		this->register_module(sigmoid1);
 		this->register_module(linear2);
 	}
 
@@ -2,89 +2,67 @@
 #define LOAD_DATA_HPP
 
 // General headers
-#include <algorithm>
 #include <iostream>
-#include <fstream>
-#include <vector> 
+#include <positnn/positnn>
+#include <vector>
 
-void load_data(	const std::string& input_path,
+template <typename T>
+int load_data(	const std::string& input_path,
 				const std::string& output_path,
-				std::vector<std::vector<float>>& input,
-				std::vector<float>& output ){
+				StdTensor<T>& input,
+				StdTensor<T>& output ){
 // Receives input and output samples paths
-// Receives two vectors of where to store the input and output data
-// Input will be a vector and output a single value
+// Receives two tensors where to store the input and output data
+// Input will have shape {samples, values per line} and output {samples, 1}
+// Values are parsed in parallel directly to T (e.g. posits)
 
 	using namespace std;
 
-	string line;
-	size_t idx;
-	float n;
-	size_t n_lines, n_columns;
-
 	cout << "Loading input data from " << input_path << endl;
 
-	// Open input file
-	ifstream in_file(input_path);
-
-	if (in_file.is_open()) {
-		// Count number of lines
-		n_lines = std::count(	std::istreambuf_iterator<char>(in_file), 
-        		     			std::istreambuf_iterator<char>(), '\n');	
-		in_file.seekg (0);	// return to file beginning
-		
-		// Count # of numbers per line
-		getline(in_file, line);
-		n_columns = std::count(line.begin(), line.end(), ' ') + 1;
-		in_file.seekg (0);	// return to file beginning
-
-		// Resize vector of samples
-		input.resize(n_lines);
-
-		// Loop through lines and extract columns to make up an input vector
-    	for (size_t i=0; i<n_lines; i++){ 
-			getline(in_file, line);
-
-			input[i].resize(n_columns);
-
-			idx = 0;	// start at the first float
-			for (size_t j=0; j<n_columns; j++){
-				line = line.substr(idx);	// get the float after idx
-				n = std::stof(line, &idx);	// parse float and point to next float
-				input[i][j] = n;			// store float in input vector
-			}
-    	}
-		in_file.close();
+	TextDataReader in_file;
+	if(in_file.open(input_path) != 0) {
+		cout << "Unable to open file" << endl;
+		return -1;
 	}
-	else cout << "Unable to open file"; 
+	in_file.read(input);
 
 	cout << "Loading output data from " << output_path << endl;
 
-	// Open output file
-	ifstream out_file(output_path);
-
-	if (out_file.is_open()) {
-		// Count number of lines
-		n_lines = std::count(	std::istreambuf_iterator<char>(out_file), 
-        		     			std::istreambuf_iterator<char>(), '\n');	
-		out_file.seekg (0);	// return to file beginning
-		
-		// Resize vector of samples
-		output.resize(n_lines);
-
-		// Loop through lines and extract value
-    	for (size_t i=0; i<n_lines; i++){ 
-			getline(out_file, line);
-			n = std::stof(line, &idx);	// parse float
-			output[i] = n;				// store float as output
-    	}
-		out_file.close();
+	TextDataReader out_file;
+	if(out_file.open(output_path) != 0) {
+		cout << "Unable to open file" << endl;
+		return -1;
 	}
-	else cout << "Unable to open file"; 
+	out_file.read(output);
+
+	cout << "input size = " << input.shape()[0] << " output size = " << output.shape()[0] << endl;
+
+	return 0;
+}
+
+void load_data(	const std::string& input_path,
+				const std::string& output_path,
+				std::vector<std::vector<float>>& input,
+				std::vector<float>& output ){
+// Receives input and output samples paths
+// Receives two vectors of where to store the input and output data
+// Input will be a vector and output a single value
+
+	StdTensor<float> input_tensor, output_tensor;
+
+	if(load_data(input_path, output_path, input_tensor, output_tensor) != 0)
+		return;
+
+	size_t const n_lines = input_tensor.shape()[0];
+	size_t const n_columns = input_tensor.shape()[1];
+	std::vector<float> const& input_data = input_tensor.vector();
 
-	cout << "input size = " << input.size() << " output size = " << output.size() << endl;
+	input.resize(n_lines);
+	for (size_t i=0; i<n_lines; i++)
+		input[i].assign(input_data.begin() + i*n_columns, input_data.begin() + (i+1)*n_columns);
 
-	return;
+	output = output_tensor.vector();
 }
 
 #endif /* LOAD_DATA_HPP */
@@ -0,0 +1,80 @@
+#ifndef ADAPTIVEAVGPOOL2D_HPP
+#define ADAPTIVEAVGPOOL2D_HPP
+
+// General headers
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "../tensor/averagepool.hpp"
+#include "../tensor/channels_last.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Average pooling to an output of fixed height and width, whatever the size of the input
+// (e.g. before the classifier, so the first Linear doesn't depend on the size of the images)
+template <typename ForwardT, typename BackwardT=ForwardT>
+class AdaptiveAvgPool2d {
+public:
+	AdaptiveAvgPool2d(size_t _output_size) :
+		AdaptiveAvgPool2d(_output_size, _output_size)
+	{ }
+
+	AdaptiveAvgPool2d(size_t _output_height, size_t _output_width) :
+		output_height(_output_height),
+		output_width(_output_width)
+	{ }
+
+	// Layout of the input and output (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
+	}
+
+	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x) {
+		PROFILE_SCOPE("forward", x);
+		input_shape = x.shape();
+		StdTensor<ForwardT> y = (layout == Layout::channels_last) ?
+			adaptive_averagepool2d_channels_last(x, output_height, output_width) :
+			adaptive_averagepool2d(x, output_height, output_width);
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> shape) const {
+		size_t const h = (layout == Layout::channels_last) ? 1 : 2;
+		shape[h] = output_height;
+		shape[h+1] = output_width;
+		return shape;
+	}
+
+	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& delta) {
+		PROFILE_SCOPE("backward", delta);
+		StdTensor<BackwardT> deltaN = (layout == Layout::channels_last) ?
+			adaptive_averagepool2d_backward_channels_last(delta, input_shape) :
+			adaptive_averagepool2d_backward(delta, input_shape);
+		PROFILE_OUTPUT(deltaN);
+		return deltaN;
+	}
+
+private:
+	size_t output_height;
+	size_t output_width;
+	std::vector<size_t> input_shape;
+	Layout layout = Layout::channels_first;
+	PROFILE_NAME("AdaptiveAvgPool2d")
+};
+
+// Average of each channel, i.e. {N, C, H, W} to {N, C, 1, 1} (or {N, 1, 1, C} with channels last)
+// Usually followed by Flatten, instead of flattening all the positions to a large Linear
+template <typename ForwardT, typename BackwardT=ForwardT>
+class GlobalAvgPool2d : public AdaptiveAvgPool2d<ForwardT, BackwardT> {
+public:
+	GlobalAvgPool2d() :
+		AdaptiveAvgPool2d<ForwardT, BackwardT>(1, 1)
+	{ }
+};
+
+#endif /* ADAPTIVEAVGPOOL2D_HPP */
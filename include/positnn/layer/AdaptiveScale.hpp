@@ -9,8 +9,9 @@
 // Custom headers
 //#include "Layer.hpp"
 #include "../layer/Parameter.hpp"
-#include "../tensor/StdTensor.hpp"
 #include "../tensor/stats.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "../tensor/TensorStats.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -27,6 +28,7 @@ public:
 		running_std(_nlayers, StatsT(1)),
 		scale(_nlayers, FactorsT(1)),
 		acc_scale(_nlayers, FactorsT(1)),
+		stats(_nlayers),
 		nlayers(_nlayers),
 		mode(_mode),
 		momentum(_momentum),
@@ -129,40 +131,90 @@ public:
 		return running_std;
 	}
 
+	// Saturation, underflow and histogram of the deltas of each layer (last setup step)
+	std::vector<TensorStats>& range_stats() {
+		return stats;
+	}
+
+	// Maximum # of elements of each tensor used to estimate the std (0 = all, with quires, the default)
+	// A sampled std doesn't need other passes through the delta and the weights, but is only an estimate
+	void set_samples(size_t const _max_samples) {
+		max_samples = _max_samples;
+	}
+
 	void print_stats() {
 		std::cout << " n: " << n << std::endl;
 		std::cout << " stdev: " << std << std::endl;
 		std::cout << " running: " << running_std << std::endl;
 		std::cout << " scale: " << scale << std::endl;
 		std::cout << " acc_scale: " << acc_scale << std::endl;
+		print_tensor_stats(stats);
 	}
 
 private:
 	template <typename BackwardT>
 	StatsT estimate_std(size_t const i, StdTensor<BackwardT> const& x, bool linear) {
 		size_t idx = std::accumulate(nparameters.begin(), nparameters.begin()+i, static_cast<size_t>(0));
+		StdTensor<OptimizerT> const& weight = parameters[idx].weight;
+
+		// Exact, unless set_samples was used and the tensors are larger than the samples
+		if(max_samples == 0 || (x.size() <= max_samples && weight.size() <= max_samples)) {
+			stats[i] = tensor_stats(x);
+			return exact_std(x, weight, linear);
+		}
+
+		// Statistics of samples of delta and weight (one pass, without copies)
+		stats[i] = tensor_stats(x, max_samples);
+		TensorStats const weight_stats = tensor_stats(weight, max_samples);
+
+		StatsT var1(stats[i].var());
+		StatsT std;
+
+		if(linear) {
+			StatsT mean1(stats[i].mean());
+			StatsT mean2(weight_stats.mean());
+			StatsT var2(weight_stats.var());
+
+			mean1 *= mean1;
+			mean2 *= mean2;
+
+			std = sqrt((var1+mean1)*(var2+mean2)-(mean1*mean2));
+			std *= std::sqrt(weight.shape()[1]);
+		}
+		else {
+			// Sum of the squares of the weights estimated from the samples
+			StatsT const sum_sq(weight_stats.sum_sq / weight_stats.samples * weight.size());
+
+			std = sqrt(var1*sum_sq/weight.shape()[1]);
+		}
+
+		return std;
+	}
+
+	template <typename BackwardT>
+	StatsT exact_std(StdTensor<BackwardT> const& x, StdTensor<OptimizerT> const& weight, bool linear) const {
 		StatsT var1 = calculate_var<StatsT>(x);
 		StatsT std;
 
 		if(linear) {
 			StatsT mean1 = calculate_mean<StatsT>(x);
-			StatsT mean2 = calculate_mean<StatsT>(parameters[idx].weight);
-			StatsT var2 = calculate_var<StatsT>(parameters[idx].weight);
+			StatsT mean2 = calculate_mean<StatsT>(weight);
+			StatsT var2 = calculate_var<StatsT>(weight);
 
 			mean1 *= mean1;
 			mean2 *= mean2;
 
 			std = sqrt((var1+mean1)*(var2+mean2)-(mean1*mean2));
-			std *= std::sqrt(parameters[idx].weight.shape()[1]);
+			std *= std::sqrt(weight.shape()[1]);
 		}
 		else {
-			StdTensor<StatsT> weight = parameters[idx].weight;
+			StdTensor<StatsT> square = weight;
 
 			// TODO: implement with quires?
-			weight *= weight;	// square
-			weight *= var1;
+			square *= square;
+			square *= var1;
 
-			std = sqrt(weight.sum()/weight.shape()[1]);
+			std = sqrt(square.sum()/weight.shape()[1]);
 		}
 
 		return std;
@@ -173,6 +225,8 @@ private:
 	std::vector<StatsT> running_std;
 	std::vector<FactorsT> scale;
 	std::vector<FactorsT> acc_scale;
+	std::vector<TensorStats> stats;
+	size_t max_samples = 0;
 
 	size_t const nlayers;
 	State state;
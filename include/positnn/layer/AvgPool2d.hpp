@@ -7,7 +7,9 @@
 // Custom headers
 //#include "Layer.hpp"
 #include "../tensor/averagepool.hpp"
+#include "../tensor/channels_last.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -20,18 +22,36 @@ public:
 		kernel_size(_kernel_size),
 		padding(_padding)
 	{ 
-		if(_stride==0)
-			stride = _kernel_size;
+		stride = (_stride==0) ? _kernel_size : _stride;
+	}
+
+	// Layout of the input and output (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
 	}
 
 	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x) {
+		PROFILE_SCOPE("forward", x);
 		input_shape = x.shape();
-		return averagepool2d(x, kernel_size, stride, padding, &w1);
+		StdTensor<ForwardT> y = (layout == Layout::channels_last) ?
+			averagepool2d_channels_last(x, kernel_size, stride, padding) :
+			averagepool2d(x, kernel_size, stride, padding);
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> const& shape) const {
+		return window2d_output_shape(shape, layout, 0, kernel_size, stride, padding);
 	}
 
 	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& delta) {
+		PROFILE_SCOPE("backward", delta);
 		// set deltaN_1 by blocks to the value of delta
-		return averagepool2d_backward(delta, input_shape, kernel_size, stride, padding, &w2);
+		StdTensor<BackwardT> deltaN = (layout == Layout::channels_last) ?
+			averagepool2d_backward_channels_last(delta, input_shape, kernel_size, stride, padding) :
+			averagepool2d_backward(delta, input_shape, kernel_size, stride, padding);
+		PROFILE_OUTPUT(deltaN);
+		return deltaN;
 	}
 
 private:
@@ -39,7 +59,8 @@ private:
 	size_t stride;
 	size_t padding;
 	std::vector<size_t> input_shape;
-	Window w1, w2;
+	Layout layout = Layout::channels_first;
+	PROFILE_NAME("AvgPool2d")
 };
 
 #endif /* AVGPOOL2D_HPP */
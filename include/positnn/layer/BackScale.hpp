@@ -10,6 +10,7 @@
 #include "../layer/Parameter.hpp"
 #include "../tensor/StdTensor.hpp"
 #include "../tensor/stats.hpp"
+#include "../tensor/TensorStats.hpp"
 #include "../utils/Quire.hpp"
 
 // Namespaces
@@ -27,6 +28,7 @@ public:
 		running_std(_nlayers, StatsT(1)),
 		scale(_nlayers, FactorsT(1)),
 		acc_scale(_nlayers, FactorsT(1)),
+		stats(_nlayers),
 		nlayers(_nlayers),
 		mode(_mode),
 		momentum(_momentum),
@@ -42,7 +44,16 @@ public:
 	StdTensor<BackwardT> backward(size_t const i, StdTensor<BackwardT> x) {
 		if(state==setuping || state==setuping_with_scale) {
 			n[i] = x.size();
-			std[i] = calculate_std<StatsT>(x);
+
+			// Exact (with quires), unless set_samples was used and x is larger than the samples
+			if(max_samples > 0 && x.size() > max_samples) {
+				stats[i] = tensor_stats(x, max_samples);
+				std[i] = StatsT(stats[i].std());
+			}
+			else {
+				stats[i] = tensor_stats(x);
+				std[i] = calculate_std<StatsT>(x);
+			}
 
 			if(state==setuping_with_scale && i+1<nlayers && !acc_scale[i+1].isone())
 				std[i] *= acc_scale[i+1];
@@ -154,12 +165,24 @@ public:
 		return running_std;
 	}
 
+	// Saturation, underflow and histogram of the deltas of each layer (last setup step)
+	std::vector<TensorStats>& range_stats() {
+		return stats;
+	}
+
+	// Maximum # of elements of each delta used to estimate its std (0 = all, with quires, the default)
+	// A sampled std doesn't need another pass through the delta, but is only an estimate
+	void set_samples(size_t const _max_samples) {
+		max_samples = _max_samples;
+	}
+
 	void print_stats() {
 		std::cout << " n: " << n << std::endl;
 		std::cout << " stdev: " << std << std::endl;
 		std::cout << " running: " << running_std << std::endl;
 		std::cout << " scale: " << scale << std::endl;
 		std::cout << " acc_scale: " << acc_scale << std::endl;
+		print_tensor_stats(stats);
 	}
 
 	typedef FactorsT factors_type;
@@ -435,6 +458,8 @@ private:
 	std::vector<StatsT> running_std;
 	std::vector<BackwardT> scale;
 	std::vector<OptimizerT> acc_scale;
+	std::vector<TensorStats> stats;
+	size_t max_samples = 0;
 
 	size_t const nlayers;
 	State state;
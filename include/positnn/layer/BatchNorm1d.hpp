@@ -2,14 +2,18 @@
 #define BATCHNORM1D_HPP
 
 // General headers
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
 #include "Layer.hpp"
+#include "../tensor/batchnorm.hpp"
 #include "../tensor/matrix.hpp"
+#include "../tensor/stats.hpp"
 #include "../tensor/sum.hpp"
 #include "../tensor/StdTensor.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -24,16 +28,17 @@ public:
 		affine(_affine), track_running_stats(_track_running_stats),
 		gamma(_num_features), beta(_num_features),   
 		gamma_gradient(_num_features), beta_gradient(_num_features),
-		stddev(_num_features)
-		
+		stddev(_num_features), inv_stddev(_num_features)
 	{
 		if(track_running_stats){
 			running_mean = StdTensor<Posit>(num_features);
 			running_variance = StdTensor<Posit>(num_features);
 		}
 
-		this->register_parameter(gamma, gamma_gradient);
-		this->register_parameter(beta, beta_gradient);
+		this->register_parameter(gamma, gamma_gradient, "weight");
+		this->register_parameter(beta, beta_gradient, "bias");
+		this->register_buffer(running_mean, "running_mean");
+		this->register_buffer(running_variance, "running_var");
 
 		reset_parameters();
 	}
@@ -48,8 +53,14 @@ public:
 	}
 
 	StdTensor<Posit> forward(StdTensor<Posit>& x) {
+		PROFILE_SCOPE("forward", x);
+		bool const save = Layer<Posit>::save_for_backward();
 		StdTensor<Posit> y;
 
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		if(!save)
+			x_norm = StdTensor<Posit>();
+
 		if(Layer<Posit>::training || !track_running_stats) {
 			// calculate mean and variance
 			StdTensor<Posit> mean(num_features);
@@ -61,24 +72,22 @@ public:
 				update_running_mean_variance(mean, variance);
 			}
 			
-			// normalize
-			y = normalize(x, mean, variance);	
-			x_norm = y;
+			// normalize, scale and shift
+			y = normalize(x, mean, variance, save ? &x_norm : NULL);
 		}
 		else {
-			y = normalize(x, running_mean, running_variance);	
-		}
-
-		//scale and shift
-		if(affine) {
-			y *= gamma;
-			y += beta;
+			y = normalize(x, running_mean, running_variance);
 		}
 
+		PROFILE_OUTPUT(y);
 		return y;
 	}
 
 	StdTensor<Posit> backward(StdTensor<Posit> delta) {
+		PROFILE_SCOPE("backward", delta);
+		if(x_norm.size() != delta.size())
+			throw std::logic_error( "backward of BatchNorm1d needs a forward in training with gradient enabled" );
+
 		if(affine)
 			gradient(delta);
 
@@ -101,6 +110,7 @@ public:
 
 		delta_1 /= (stddev*batch_size);
 
+		PROFILE_OUTPUT(delta_1);
 		return delta_1;
 
 		/*
@@ -114,6 +124,7 @@ public:
 	}
 
 	void gradient(StdTensor<Posit> delta) {
+		PROFILE_SCOPE("gradient", delta);
 		StdTensor<Posit> temp_beta_gradient = sum_first(delta);
 
 		//delta *= x_norm;
@@ -131,85 +142,31 @@ public:
 		return;
 	}
 
-	void calculate_mean_variance(	StdTensor<Posit>& x,
+	// Mean and variance of each feature (see channel_mean_variance)
+	void calculate_mean_variance(	StdTensor<Posit> const& x,
 									StdTensor<Posit>& mean,
 									StdTensor<Posit>& variance	) {
 
-		constexpr size_t nbits = Posit::nbits;
-		constexpr size_t es = Posit::es;
-
-		size_t const size = x.size();
-		size_t const batch_size = x.shape()[0];
-		
-		/*
-		Quire<nbits, es> sum, sq_sum;
-
-		for(size_t i=0; i<num_features; i++){
-			sum = sq_sum = 0;
-			for(size_t j=i; j<size; j+=num_features){
-				sum += x[j];
-				sq_sum += Quire_mul(x[j], x[j]);
-			}
-			convert(sum.to_value(), mean[i]);
-			convert(sq_sum.to_value(), variance[i]);
-
-			mean[i] /= batch_size;
-
-			variance[i] /= batch_size;
-			variance[i] -= mean[i]*mean[i];
-		}
-		*/
-
-		Quire<nbits, es> sum;
-
-		// Calculate mean
-		for(size_t i=0; i<num_features; i++){
-			sum = 0;
-			for(size_t j=i; j<size; j+=num_features){
-				sum += x[j];
-			}
-			convert(sum.to_value(), mean[i]);
-
-			mean[i] /= batch_size;
-		}
-
-		// Calculate variance
-		for(size_t i=0; i<num_features; i++){
-			sum = 0;
-			for(size_t j=i; j<size; j+=num_features){
-				Posit delta = x[j] - mean[i];
-				sum += Quire_mul(delta, delta);
-			}
-			convert(sum.to_value(), variance[i]);
-
-			variance[i] /= batch_size;
-		}
-
-		return;
+		channel_mean_variance(x, num_features, 1, mean, variance);
 	}
 
-	StdTensor<Posit> normalize(	StdTensor<Posit>& x,
-								StdTensor<Posit>& mean,
-								StdTensor<Posit>& variance	) {
+	// Normalize x, then scale and shift it (if affine), in a single pass through x
+	// Features are multiplied by 1/stddev, so the division is only done once per feature
+	// The normalized x is also stored in normalized if not NULL
+	StdTensor<Posit> normalize(	StdTensor<Posit> const& x,
+								StdTensor<Posit> const& mean,
+								StdTensor<Posit> const& variance,
+								StdTensor<Posit>* normalized=NULL	) {
 
-		// Calculate standard deviation
+		// Calculate standard deviation and its reciprocal
 		for(size_t i=0; i<num_features; i++) {
 			stddev[i] = sqrt(variance[i]+eps);
+			inv_stddev[i] = Posit(1) / stddev[i];
 		}
 
-		size_t const size = x.size();
-		StdTensor<Posit> y = x;
+		COUNT_OPS(Posit, OP_EXP_LOG, num_features);
 
-		for(size_t i=0, j=0; i<size; i++, j++) {
-			if(j >= num_features)
-				j = 0;
-			// Subtract mean
-			y[i] -= mean[j];
-			// Divide by standard deviation
-			y[i] /= stddev[j];
-		}
-
-		return y;
+		return batchnorm_forward(x, mean, inv_stddev, affine ? gamma : StdTensor<Posit>(), beta, 1, normalized);
 	}
 
 	void update_running_mean_variance(	StdTensor<Posit>& mean,
@@ -226,20 +183,6 @@ public:
 		fused(running_variance, variance, 1-momentum, momentum);
 	}
 
-	template <typename PositFile=Posit>
-	void write(std::ostream& out) {
-		Layer<Posit>::write(out);	
-		running_mean.template write<PositFile>(out);
-		running_variance.template write<PositFile>(out);
-	}
-
-	template <typename PositFile=Posit>
-	void read(std::istream& in) {
-		Layer<Posit>::read(in);	
-		running_mean.template read<PositFile>(in);
-		running_variance.template read<PositFile>(in);
-	}
-
 private:
 	size_t const num_features;
 	Posit eps;
@@ -256,7 +199,9 @@ private:
 	StdTensor<Posit> running_variance;
 
 	StdTensor<Posit> stddev;
+	StdTensor<Posit> inv_stddev;
 	StdTensor<Posit> x_norm;
+	PROFILE_NAME("BatchNorm1d")
 };
 
 #endif /* BATCHNORM1D_HPP */
@@ -0,0 +1,243 @@
+#ifndef BATCHNORM2D_HPP
+#define BATCHNORM2D_HPP
+
+// General headers
+#include <stdexcept>
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "Layer.hpp"
+#include "../tensor/batchnorm.hpp"
+#include "../tensor/channels_last.hpp"
+#include "../tensor/matrix.hpp"
+#include "../tensor/stats.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "../utils/Quire.hpp"
+#include "../utils/Profiler.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Batch normalization of each channel of {N, C, H, W} (or {N, H, W, C} with channels last),
+// with statistics over the samples and positions of that channel
+// For inference, it can be folded into the preceding convolution (see fold_into)
+template <typename Posit>
+class BatchNorm2d : public Layer<Posit> {
+public:
+	BatchNorm2d(size_t _num_features, Posit _eps=1e-5, Posit _momentum=0.1,
+				bool _affine=true, bool _track_running_stats=true) :
+		num_features(_num_features),
+		eps(_eps), momentum(_momentum),
+		affine(_affine), track_running_stats(_track_running_stats),
+		gamma(_num_features), beta(_num_features),
+		gamma_gradient(_num_features), beta_gradient(_num_features),
+		inv_stddev(_num_features)
+	{
+		if(track_running_stats){
+			running_mean = StdTensor<Posit>(num_features);
+			running_variance = StdTensor<Posit>(num_features);
+		}
+
+		this->register_parameter(gamma, gamma_gradient, "weight");
+		this->register_parameter(beta, beta_gradient, "bias");
+		this->register_buffer(running_mean, "running_mean");
+		this->register_buffer(running_variance, "running_var");
+
+		reset_parameters();
+	}
+
+	void reset_parameters() {
+		gamma.set(Posit(1));
+		beta.set(Posit(0));
+
+		running_mean.set(Posit(0));
+		running_variance.set(Posit(1));
+	}
+
+	// Layout of the input and output (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
+	}
+
+	StdTensor<Posit> forward(StdTensor<Posit> const& x) {
+		PROFILE_SCOPE("forward", x);
+
+		// Already applied by the convolution
+		if(folded)
+			return x;
+
+		size_t const inner = inner_size(x);
+		bool const save = Layer<Posit>::save_for_backward();
+		StdTensor<Posit> y;
+
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		if(!save)
+			x_norm = StdTensor<Posit>();
+
+		if(Layer<Posit>::training || !track_running_stats) {
+			// calculate mean and variance
+			StdTensor<Posit> mean(num_features);
+			StdTensor<Posit> variance(num_features);
+			channel_mean_variance(x, num_features, inner, mean, variance);
+
+			if(track_running_stats) {
+				fused(running_mean, mean, 1-momentum, momentum);
+				fused(running_variance, variance, 1-momentum, momentum);
+			}
+
+			calculate_inv_stddev(variance, inv_stddev);
+
+			// normalize, scale and shift
+			y = batchnorm_forward(	x, mean, inv_stddev, affine ? gamma : StdTensor<Posit>(), beta,
+									inner, save ? &x_norm : NULL	);
+		}
+		else {
+			StdTensor<Posit> scale, shift;
+			running_scale_shift(scale, shift);
+			y = batchnorm_scale_shift(x, scale, shift, inner);
+		}
+
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	StdTensor<Posit> backward(StdTensor<Posit> const& delta) {
+		PROFILE_SCOPE("backward", delta);
+		if(folded)
+			return delta;
+
+		if(x_norm.size() != delta.size())
+			throw std::logic_error( "backward of BatchNorm2d needs a forward in training with gradient enabled" );
+
+		size_t const inner = inner_size(delta);
+		size_t const count = delta.size() / num_features;
+
+		// Sums of delta and delta*x_norm of each channel, used by the gradients and the delta
+		std::vector<Quire<Posit::nbits, Posit::es>> sum, sum_product;
+		channel_sums(delta, x_norm, num_features, inner, sum, sum_product);
+
+		StdTensor<Posit> mean_delta(num_features);
+		StdTensor<Posit> mean_delta_x_norm(num_features);
+		for(size_t c=0; c<num_features; c++) {
+			convert(sum[c].to_value(), mean_delta[c]);
+			convert(sum_product[c].to_value(), mean_delta_x_norm[c]);
+		}
+
+		// Gradients use the sums, averaged over the samples only (like Conv2d)
+		if(affine)
+			gradient(mean_delta_x_norm, mean_delta, delta.shape()[0]);
+
+		mean_delta /= count;
+		mean_delta_x_norm /= count;
+
+		StdTensor<Posit> scale = inv_stddev;
+		if(affine)
+			scale *= gamma;
+
+		StdTensor<Posit> delta_1 = batchnorm_backward(delta, x_norm, mean_delta, mean_delta_x_norm, scale, inner);
+
+		PROFILE_OUTPUT(delta_1);
+		return delta_1;
+	}
+
+	// Gradients of gamma and beta from the sums of delta*x_norm and delta of each channel
+	void gradient(	StdTensor<Posit> temp_gamma_gradient,
+					StdTensor<Posit> temp_beta_gradient,
+					size_t const batch_size	) {
+
+		if(batch_size>1) {
+			temp_beta_gradient /= batch_size;
+			temp_gamma_gradient /= batch_size;
+		}
+
+		beta_gradient += temp_beta_gradient;
+		gamma_gradient += temp_gamma_gradient;
+	}
+
+	// Scale and shift of each channel with the running statistics
+	// scale = gamma / sqrt(running_variance + eps) and shift = beta - running_mean * scale
+	void running_scale_shift(StdTensor<Posit>& scale, StdTensor<Posit>& shift) const {
+		scale = StdTensor<Posit>(num_features);
+		shift = StdTensor<Posit>(num_features);
+
+		calculate_inv_stddev(running_variance, scale);
+
+		Quire<Posit::nbits, Posit::es> q;
+		for(size_t c=0; c<num_features; c++) {
+			if(affine) {
+				scale[c] *= gamma[c];
+				q = beta[c];
+			}
+			else {
+				q.clear();
+			}
+
+			q -= Quire_mul(running_mean[c], scale[c]);
+			convert(q.to_value(), shift[c]);
+		}
+	}
+
+	// Fold the normalization with the running statistics into the convolution before this layer
+	// (e.g. Conv2d), which has to provide scale_shift_output, and skip this layer from now on
+	// This is only for inference: train and save the model before, since its parameters are changed
+	template <typename Convolution>
+	void fold_into(Convolution& conv) {
+		if(folded)
+			return;
+
+		if(!track_running_stats)
+			throw std::invalid_argument( "BatchNorm2d without running stats can't be folded" );
+
+		StdTensor<Posit> scale, shift;
+		running_scale_shift(scale, shift);
+		conv.scale_shift_output(scale, shift);
+
+		folded = true;
+	}
+
+	bool is_folded() const {
+		return folded;
+	}
+
+private:
+	// Size of the inner axis of the input seen as {outer, num_features, inner} (see channel_sums)
+	size_t inner_size(StdTensor<Posit> const& x) const {
+		bool const channels_last = (layout == Layout::channels_last);
+		size_t const channel_axis = (channels_last) ? 3 : 1;
+
+		if(x.dim() != 4 || x.shape()[channel_axis] != num_features)
+			throw std::invalid_argument( "BatchNorm2d expects an input with num_features channels and 4 dimensions" );
+
+		return (channels_last) ? 1 : x.shape()[2]*x.shape()[3];
+	}
+
+	void calculate_inv_stddev(StdTensor<Posit> const& variance, StdTensor<Posit>& result) const {
+		for(size_t c=0; c<num_features; c++)
+			result[c] = Posit(1) / sqrt(variance[c]+eps);
+
+		COUNT_OPS(Posit, OP_EXP_LOG, num_features);
+	}
+
+	size_t const num_features;
+	Posit eps;
+	Posit momentum;
+	bool affine;
+	bool track_running_stats;
+	bool folded = false;
+	Layout layout = Layout::channels_first;
+
+	StdTensor<Posit> gamma;
+	StdTensor<Posit> beta;
+	StdTensor<Posit> gamma_gradient;
+	StdTensor<Posit> beta_gradient;
+
+	StdTensor<Posit> running_mean;
+	StdTensor<Posit> running_variance;
+
+	StdTensor<Posit> inv_stddev;
+	StdTensor<Posit> x_norm;
+	PROFILE_NAME("BatchNorm2d")
+};
+
+#endif /* BATCHNORM2D_HPP */
@@ -3,33 +3,45 @@
 
 // General headers
 #include <cmath>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 // Custom headers
 #include "init.hpp"
 #include "Layer.hpp"
+#include "../tensor/channels_last.hpp"
 #include "../tensor/convolution.hpp"
 #include "../tensor/MixedTensor.hpp"
 #include "../tensor/sum.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
+#include "../utils/Quire.hpp"
 
 template <typename OptimizerT, typename ForwardT=OptimizerT, typename BackwardT=ForwardT, typename GradientT=BackwardT>
 class Conv2d : public Layer<OptimizerT> {
-// TODO: implement dilation
 public:
-	Conv2d(size_t _in_channels, size_t _out_channels, size_t _kernel_size, size_t _stride=1, size_t _padding=0, size_t _dilation=1) :
+	// With groups>1, each output channel only uses the in_channels/groups input channels of its group
+	// (e.g. depthwise convolution with groups = in_channels)
+	Conv2d(size_t _in_channels, size_t _out_channels, size_t _kernel_size, size_t _stride=1, size_t _padding=0, size_t _dilation=1,
+			size_t _groups=1) :
 		in_channels(_in_channels),
 		out_channels(_out_channels),
 		kernel_size(_kernel_size),
 		stride(_stride),
 		padding(_padding),
 		dilation(_dilation),
-		weight({out_channels, in_channels, kernel_size, kernel_size}),
+		groups(_groups),
+		weight({out_channels, (groups>0) ? in_channels/groups : 0, kernel_size, kernel_size}),
 		bias(out_channels),
-		weight_gradient({out_channels, in_channels, kernel_size, kernel_size}),
+		weight_gradient({out_channels, (groups>0) ? in_channels/groups : 0, kernel_size, kernel_size}),
 		bias_gradient(out_channels)
 	{
-		this->register_parameter(weight, weight_gradient);
-		this->register_parameter(bias, bias_gradient);
+		if(groups==0 || in_channels % groups != 0 || out_channels % groups != 0)
+			throw std::invalid_argument( "in_channels and out_channels of Conv2d should be divisible by groups" );
+
+		this->register_parameter(weight, weight_gradient, "weight");
+		this->register_parameter(bias, bias_gradient, "bias");
 
 		reset_parameters();
 	}
@@ -38,22 +50,54 @@ public:
 		std::cerr << "Conv2d layer is not initialized" << std::endl;
 	}
 
+	// Layout of the input and output (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
+	}
+
+	// The output is computed in the memory of storage if it is large enough (see Sequential)
 	template <typename T>
-	StdTensor<ForwardT> forward(StdTensor<T> const& x) {
-		input = x;
-		return convolution2d<ForwardT::nbits, ForwardT::es>(x, weight.get_forward(), bias.get_forward(), stride, padding, 1, dilation, &w1);
+	StdTensor<ForwardT> forward(StdTensor<T> const& x, StdTensor<ForwardT> storage=StdTensor<ForwardT>()) {
+		PROFILE_SCOPE("forward", x);
+
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		if(this->save_for_backward())
+			input = x;
+		else
+			input = StdTensor<GradientT>();
+
+		StdTensor<ForwardT> y = (layout == Layout::channels_last) ?
+			convolution2d_channels_last<ForwardT::nbits, ForwardT::es>(x, weight.get_forward(), bias.get_forward(), stride, padding, dilation, groups) :
+			convolution2d<ForwardT::nbits, ForwardT::es>(x, weight.get_forward(), bias.get_forward(), stride, padding, 1, dilation, groups, NULL, std::move(storage));
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> const& shape) const {
+		return window2d_output_shape(shape, layout, out_channels, kernel_size, stride, padding, dilation);
 	}
 
 	template <typename T>
 	StdTensor<BackwardT> backward(StdTensor<T> const& delta) {
+		PROFILE_SCOPE("backward", delta);
+		if(input.dim() != 4)
+			throw std::logic_error( "backward of Conv2d needs a forward in training with gradient enabled" );
+
 		gradient(delta);
-		StdTensor<BackwardT> rotated = rotate_weight(weight.get_backward());
-		return convolution2d<BackwardT::nbits, BackwardT::es>(delta, rotated, StdTensor<BackwardT>(), 1, (kernel_size-1)*dilation-padding, stride, dilation, &w3);
+		StdTensor<BackwardT> deltaN = (layout == Layout::channels_last) ?
+			convolution2d_input_gradient_channels_last<BackwardT::nbits, BackwardT::es>(delta, weight.get_backward(), input.shape()[1], input.shape()[2], stride, padding, dilation, groups) :
+			convolution2d_input_gradient<BackwardT::nbits, BackwardT::es>(delta, weight.get_backward(), input.shape()[2], input.shape()[3], stride, padding, dilation, groups);
+		PROFILE_OUTPUT(deltaN);
+		return deltaN;
 	}
 
 	void gradient(StdTensor<GradientT> const& delta) {
-		StdTensor<GradientT> temp_weight_gradient = convolution2d_gradient(input, delta, stride, padding, dilation, &w2);
-		StdTensor<GradientT> temp_bias_gradient = sum_last2(delta);
+		PROFILE_SCOPE("gradient", delta);
+		bool const channels_last = (layout == Layout::channels_last);
+		StdTensor<GradientT> temp_weight_gradient = (channels_last) ?
+			convolution2d_gradient_channels_last(input, delta, stride, padding, dilation, groups) :
+			convolution2d_gradient(input, delta, stride, padding, dilation, groups);
+		StdTensor<GradientT> temp_bias_gradient = (channels_last) ? sum_spatial_channels_last(delta) : sum_last2(delta);
 
 		// If there are many samples
 		if(input.dim()>1 && input.shape()[0]>1){
@@ -69,19 +113,42 @@ public:
 		return;
 	}
 
-private:
+	// Multiply each output channel by scale and add shift to it, by changing the weight and bias
+	// (e.g. to fold a following BatchNorm2d with its running stats for inference)
+	void scale_shift_output(StdTensor<OptimizerT> const& scale, StdTensor<OptimizerT> const& shift) {
+		StdTensor<OptimizerT>& w = weight.get_optimizer();
+		StdTensor<OptimizerT>& b = bias.get_optimizer();
+		size_t const channel_size = w.strides()[0];
+
+		Quire<OptimizerT::nbits, OptimizerT::es> q;
+		for(size_t o=0; o<out_channels; o++) {
+			for(size_t i=o*channel_size, i_end=i+channel_size; i<i_end; i++)
+				w[i] *= scale[o];
+
+			q = shift[o];
+			q += Quire_mul(b[o], scale[o]);
+			convert(q.to_value(), b[o]);
+		}
+
+		weight.update();
+		bias.update();
+	}
+
+protected:
 	size_t in_channels;
 	size_t out_channels;
 	size_t kernel_size;
 	size_t stride;
 	size_t padding;
 	size_t dilation;
+	size_t groups;
+	Layout layout = Layout::channels_first;
 	MixedTensor<OptimizerT, ForwardT, BackwardT> weight;
 	MixedTensor<OptimizerT, ForwardT> bias;
 	StdTensor<GradientT> input;
 	StdTensor<OptimizerT> weight_gradient;
 	StdTensor<OptimizerT> bias_gradient;
-	Window w1, w2, w3;
+	PROFILE_NAME("Conv2d")
 };
 
 #endif /* CONV2D_HPP */
@@ -0,0 +1,136 @@
+#ifndef CONV2DMAXPOOL2DRELU_HPP
+#define CONV2DMAXPOOL2DRELU_HPP
+
+// General headers
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// Custom headers
+#include "Conv2d.hpp"
+#include "../tensor/channels_last.hpp"
+#include "../tensor/convolution_maximumpool.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
+
+// Conv2d followed by MaxPool2d and ReLU in a single pass
+// Only the pooled output is stored and, for backward, one byte per output
+// (position of the maximum in its window or RELU_ZERO) instead of the
+// output of the convolution, the indices of the maximums and the ReLU mask
+// (or a size_t, for pooling windows too large for 1 byte, see maxpool2d_byte_offsets)
+// Parameters are the same of Conv2d, so models can be saved and loaded with both
+template <typename OptimizerT, typename ForwardT=OptimizerT, typename BackwardT=ForwardT, typename GradientT=BackwardT>
+class Conv2dMaxPool2dReLU : public Conv2d<OptimizerT, ForwardT, BackwardT, GradientT> {
+public:
+	Conv2dMaxPool2dReLU(size_t _in_channels, size_t _out_channels, size_t _kernel_size, size_t _stride=1, size_t _padding=0,
+						size_t _pool_kernel_size=2, size_t _pool_stride=0, size_t _pool_padding=0) :
+		Conv2d<OptimizerT, ForwardT, BackwardT, GradientT>(_in_channels, _out_channels, _kernel_size, _stride, _padding),
+		pool_kernel_size(_pool_kernel_size),
+		pool_padding(_pool_padding)
+	{
+		pool_stride = (_pool_stride==0) ? _pool_kernel_size : _pool_stride;
+	}
+
+	// The output is pooled and rectified, so a following batch norm can't be folded into it
+	void scale_shift_output(StdTensor<OptimizerT> const&, StdTensor<OptimizerT> const&) = delete;
+
+	// The output is computed in the memory of storage if it is large enough (see Sequential)
+	template <typename T>
+	StdTensor<ForwardT> forward(StdTensor<T> const& x, StdTensor<ForwardT> storage=StdTensor<ForwardT>()) {
+		PROFILE_SCOPE("forward", x);
+		bool const save = this->save_for_backward();
+
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		if(save) {
+			this->input = x;
+		}
+		else {
+			this->input = StdTensor<GradientT>();
+			max_offset.clear();
+			large_max_offset.clear();
+		}
+
+		StdTensor<ForwardT> y = (maxpool2d_byte_offsets(pool_kernel_size)) ?
+			pool(x, (save) ? &max_offset : NULL, std::move(storage)) :
+			pool(x, (save) ? &large_max_offset : NULL, std::move(storage));
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> const& shape) const {
+		std::vector<size_t> const conv = Conv2d<OptimizerT, ForwardT, BackwardT, GradientT>::output_shape(shape);
+		return window2d_output_shape(conv, this->layout, 0, pool_kernel_size, pool_stride, pool_padding);
+	}
+
+	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& deltaN) {
+		StdTensor<BackwardT> delta = (maxpool2d_byte_offsets(pool_kernel_size)) ?
+			unpool(deltaN, max_offset) :
+			unpool(deltaN, large_max_offset);
+		return Conv2d<OptimizerT, ForwardT, BackwardT, GradientT>::backward(delta);
+	}
+
+private:
+	template <typename T, typename Offset>
+	StdTensor<ForwardT> pool(StdTensor<T> const& x, std::vector<Offset>* offsets, StdTensor<ForwardT> storage) {
+		bool const channels_last = (this->layout == Layout::channels_last);
+
+		// The windows are only looked up again if the shape of the input (or the layout) changes
+		if(pool_w == NULL || x.shape() != input_shape || channels_last != windows_channels_last) {
+			input_shape = x.shape();
+			windows_channels_last = channels_last;
+
+			conv_w = &convolution2d_window(	(channels_last) ? channels_first_shape(input_shape) : input_shape,
+											this->weight.get_forward().shape(), this->stride, this->padding, 1, this->dilation	);
+
+			conv_shape = (channels_last) ?
+				std::vector<size_t>{input_shape[0], conv_w->output_height, conv_w->output_width, this->out_channels} :
+				std::vector<size_t>{input_shape[0], this->out_channels, conv_w->output_height, conv_w->output_width};
+
+			pool_w = &pool2d_window(	(channels_last) ? channels_first_shape(conv_shape) : conv_shape,
+										pool_kernel_size, pool_stride, pool_padding	);
+		}
+
+		if(channels_last) {
+			return convolution2d_maximumpool2d_relu_channels_last<ForwardT::nbits, ForwardT::es>(
+						x, this->weight.get_forward(), this->bias.get_forward(),
+						this->stride, this->padding, this->dilation,
+						pool_kernel_size, pool_stride, pool_padding,
+						offsets, pool_w	);
+		}
+
+		return convolution2d_maximumpool2d_relu<ForwardT::nbits, ForwardT::es>(
+					x, this->weight.get_forward(), this->bias.get_forward(),
+					this->stride, this->padding, this->dilation,
+					pool_kernel_size, pool_stride, pool_padding,
+					offsets, conv_w, pool_w, std::move(storage)	);
+	}
+
+	template <typename Offset>
+	StdTensor<BackwardT> unpool(StdTensor<BackwardT> const& deltaN, std::vector<Offset> const& offsets) const {
+		if(offsets.size() != deltaN.size())
+			throw std::logic_error( "backward of Conv2dMaxPool2dReLU needs a forward in training with gradient enabled" );
+
+		// Outputs zeroed by the ReLU are like windows without maximum
+		return (this->layout == Layout::channels_last) ?
+			maximumpool2d_backward_channels_last(	deltaN, conv_shape,
+													pool_kernel_size, pool_stride, pool_padding,
+													offsets, *pool_w	) :
+			maximumpool2d_relu_backward(	deltaN, conv_shape,
+											pool_kernel_size, pool_stride,
+											offsets, *pool_w	);
+	}
+
+	size_t pool_kernel_size;
+	size_t pool_stride;
+	size_t pool_padding;
+	std::vector<size_t> input_shape;	// of the windows below
+	bool windows_channels_last = false;
+	std::vector<size_t> conv_shape;
+	std::vector<uint8_t> max_offset;
+	std::vector<size_t> large_max_offset;
+	Window const* conv_w = NULL;	// shared, see shared_window
+	Window const* pool_w = NULL;
+};
+
+#endif /* CONV2DMAXPOOL2DRELU_HPP */
@@ -7,7 +7,9 @@
 
 // Custom headers
 #include "Layer.hpp"
+#include "../tensor/BitMask.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -24,24 +26,31 @@ public:
 
 	template <typename T>
 	StdTensor<T> forward(StdTensor<T>& x) {
+		PROFILE_SCOPE("forward", x);
 		if(Layer<OptimizerT>::training) {
 			zero.resize(x.size());
-			std::generate(zero.begin(), zero.end(), [&]{ return distribution(generator); });
+			zero.generate([&]{ return distribution(generator); });
 
-			return dropout(x);
+			StdTensor<T> y = dropout(x);
+			PROFILE_OUTPUT(y);
+			return y;
 		}
 
+		PROFILE_OUTPUT(x);
 		return x;
 	}
 
 	template <typename T>
 	StdTensor<T> backward(StdTensor<T>& x) {
+		PROFILE_SCOPE("backward", x);
 		if(x.size() != zero.size()) {
 			std::cerr << "ERROR: size of x should be " << zero.size() << " instead of " << x.size() << std::endl;
 			return x;
 		}
 
-		return dropout(x);
+		StdTensor<T> deltaN = dropout(x);
+		PROFILE_OUTPUT(deltaN);
+		return deltaN;
 	}
 
 private:
@@ -121,7 +130,8 @@ private:
 	float p;
 	std::default_random_engine generator;
 	std::bernoulli_distribution distribution;
-	std::vector<bool> zero;
+	BitMask zero;
+	PROFILE_NAME("Dropout")
 };
 
 #endif /* DROPOUT_HPP */
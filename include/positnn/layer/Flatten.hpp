@@ -0,0 +1,59 @@
+#ifndef FLATTEN_HPP
+#define FLATTEN_HPP
+
+// General headers
+#include <vector>
+
+// Custom headers
+#include "../tensor/channels_last.hpp"
+#include "../tensor/StdTensor.hpp"
+
+// Reshapes samples to vectors, i.e. {N, C, H, W} to {N, C*H*W} (without copying them)
+// With channels last, samples are converted to channels first, so the following
+// layers (e.g. Linear) have the same parameters with both layouts
+class Flatten {
+public:
+	Flatten() { }
+
+	// Layout of the input (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
+	}
+
+	template <typename T>
+	StdTensor<T> forward(StdTensor<T> x) {
+		input_shape = x.shape();
+		if(layout == Layout::channels_last)
+			x = to_channels_first(x);
+
+		size_t const batch_size = (x.dim()>0) ? input_shape[0] : 1;
+		x.reshape({batch_size, (batch_size>0) ? x.size()/batch_size : 0});
+		return x;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> const& shape) const {
+		size_t const batch_size = (shape.size()>0) ? shape[0] : 1;
+		size_t size = 1;
+		for(size_t const s : shape)
+			size *= s;
+
+		return {batch_size, (batch_size>0) ? size/batch_size : 0};
+	}
+
+	template <typename T>
+	StdTensor<T> backward(StdTensor<T> delta) {
+		if(layout == Layout::channels_last && input_shape.size() == 4) {
+			delta.reshape(channels_first_shape(input_shape));
+			return to_channels_last(delta);
+		}
+
+		delta.reshape(input_shape);
+		return delta;
+	}
+
+private:
+	std::vector<size_t> input_shape;
+	Layout layout = Layout::channels_first;
+};
+
+#endif /* FLATTEN_HPP */
@@ -3,12 +3,15 @@
 
 // General headers
 #include <cmath>
+#include <string>
 
 // Custom headers
 #include "init.hpp"
 #include "Parameter.hpp"
 #include "../tensor/MixedTensor.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/ModelFile.hpp"
 
 template <typename Posit>	// Data format to be used in optimizer
 class Layer {
@@ -26,8 +29,10 @@ public:
 		return _parameters;
 	}
 
-	void register_parameter(StdTensor<Posit>& _weight, StdTensor<Posit>& _gradient) {
-		_parameters.push_back( Parameter<Posit>(_weight, _gradient) );
+	void register_parameter(StdTensor<Posit>& _weight, StdTensor<Posit>& _gradient, std::string name="") {
+		if(name.empty())
+			name = std::to_string(_parameters.size());
+		_parameters.push_back( Parameter<Posit>(_weight, _gradient, name) );
 	}
 
 	void register_parameter(Parameter<Posit>& p) {
@@ -41,9 +46,22 @@ public:
 	}
 
 	template <typename ForwardT, typename BackwardT=ForwardT>
-	void register_parameter(MixedTensor<Posit, ForwardT, BackwardT>& _weight, StdTensor<Posit>& _gradient) {
-		_parameters.push_back( Parameter<Posit>(_weight, _gradient) );
+	void register_parameter(MixedTensor<Posit, ForwardT, BackwardT>& _weight, StdTensor<Posit>& _gradient, std::string name="") {
+		if(name.empty())
+			name = std::to_string(_parameters.size());
+		_parameters.push_back( Parameter<Posit>(_weight, _gradient, name) );
+	}
+	// Buffers are saved after the parameters
+	std::vector<Buffer<Posit>>& buffers() {
+		return _buffers;
+	}
+
+	void register_buffer(StdTensor<Posit>& tensor, std::string name="") {
+		if(name.empty())
+			name = std::to_string(_buffers.size());
+		_buffers.push_back( Buffer<Posit>(tensor, name) );
 	}
+
 	/*
 	template <typename MixedTensor>
 	void register_parameter(MixedTensor& _weight, StdTensor<Posit>& _gradient) {
@@ -51,9 +69,36 @@ public:
 	}
 	*/
 
-	void register_module(Layer<Posit>& layer) {
-		register_parameter(layer.parameters());
+	void register_module(Layer<Posit>& layer, std::string name="") {
+		// Parameters of the module are named "<module>.<parameter>"
+		if(name.empty())
+			name = std::to_string(modules.size());
+
+		for(Parameter<Posit> p : layer.parameters()){
+			p.name = name + "." + p.name;
+			_parameters.push_back(p);
+		}
+
+		for(Buffer<Posit> b : layer.buffers()){
+			b.name = name + "." + b.name;
+			b.module = true;
+			_buffers.push_back(b);
+		}
+
 		modules.push_back(&layer);	
+		module_names.push_back(name);
+		layer.set_module_path(path.empty() ? name : path + "." + name);
+	}
+
+	// Modules without parameters (e.g. ReLU, MaxPool2d) are only registered so eval() and train() reach them
+	void register_module(BackwardState& module) {
+		module.set_inference(inference);
+		states.push_back(&module);
+	}
+
+	// Path of the module in the model, e.g. "features.0" (empty if it wasn't registered)
+	std::string const& module_path() const {
+		return path;
 	}
 
 	template <typename PositFile=Posit>
@@ -61,32 +106,88 @@ public:
 		for(Parameter<Posit>& p : _parameters) {
 			p.weight.template write<PositFile>(out);
 		}
+
+		for(Buffer<Posit>& b : _buffers) {
+			b.tensor.template write<PositFile>(out);
+		}
 	}
 
 	template <typename PositFile=Posit>
-	void read(std::istream& in) {
+	void read(std::istream& in, size_t const version=POSIT_FILE_VERSION) {
 		for(Parameter<Posit>& p : _parameters) {
-			p.weight.template read<PositFile>(in);
+			p.weight.template read<PositFile>(in, version);
 			p.update();
 		}
+
+		// Older files only have the buffers of the layer itself
+		for(Buffer<Posit>& b : _buffers) {
+			if(version >= 3 || !b.module)
+				b.tensor.template read<PositFile>(in, version);
+		}
+	}
+
+	// Read parameters and buffers by name from a mapped model file
+	template <typename PositFile=Posit>
+	void read(ModelFile const& file) {
+		for(Parameter<Posit>& p : _parameters) {
+			if(file.template read<PositFile>(p.name, p.weight) == 0)
+				p.update();
+		}
+
+		// Empty buffers (e.g. batch norms without running stats) aren't saved
+		for(Buffer<Posit>& b : _buffers) {
+			if(!b.tensor.empty())
+				file.template read<PositFile>(b.name, b.tensor);
+		}
 	}
 
 	void train() {
 		training = true;
+		inference = false;
 		for(Layer<Posit>* layer : modules)
 			layer->train();
+		for(BackwardState* state : states)
+			state->set_inference(false);
 	}
 
+	// Layers also stop keeping what backward needs, until train() is called
 	void eval() {
 		training = false;
+		inference = true;
 		for(Layer<Posit>* layer : modules)
 			layer->eval();
+		for(BackwardState* state : states)
+			state->set_inference(true);
+	}
+
+	// Change training (e.g. of Dropout and batch norms) without changing if layers keep what backward needs
+	void set_training(bool const _training) {
+		training = _training;
+		for(Layer<Posit>* layer : modules)
+			layer->set_training(_training);
+	}
+
+	// If forward has to keep what backward needs (not after eval() or with a NoGradGuard)
+	bool save_for_backward() const {
+		return !inference && GradMode::is_enabled();
 	}
 
 protected:
+	// Set path of the module and of its own modules
+	void set_module_path(std::string const& _path) {
+		path = _path;
+		for(size_t i=0; i<modules.size(); i++)
+			modules[i]->set_module_path(path + "." + module_names[i]);
+	}
+
 	std::vector<Parameter<Posit>> _parameters;
+	std::vector<Buffer<Posit>> _buffers;
 	std::vector<Layer<Posit>*> modules;
+	std::vector<BackwardState*> states;
+	std::vector<std::string> module_names;
+	std::string path;
 	bool training = false;
+	bool inference = false;	// eval() was called
 };
 
 #endif /* LAYER_HPP */
@@ -3,27 +3,38 @@
 
 // General headers
 #include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
 
 // Custom headers
 #include "init.hpp"
 #include "Layer.hpp"
+#include "../tensor/BitMask.hpp"
 #include "../tensor/matrix.hpp"
 #include "../tensor/MixedTensor.hpp"
 #include "../tensor/sum.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
+#include "../utils/utils.hpp"
 
 template <typename OptimizerT, typename ForwardT=OptimizerT, typename BackwardT=ForwardT, typename GradientT=BackwardT>
 class Linear : public Layer<OptimizerT> {
 // TODO: permit linear layer with no bias
 public:
-	Linear(size_t in, size_t out) :
+	// activation (ReLU, Sigmoid or Tanh) is applied to the results of the matrix
+	// multiplication before they are stored, instead of in a separate layer
+	Linear(size_t in, size_t out, Activation _activation=Activation::none) :
 		weight({out, in}),
 		bias(out),
 		weight_gradient({out, in}),
-		bias_gradient(out)
+		bias_gradient(out),
+		activation(_activation),
+		out_features(out)
 	{
-		this->register_parameter(weight, weight_gradient);
-		this->register_parameter(bias, bias_gradient);
+		this->register_parameter(weight, weight_gradient, "weight");
+		this->register_parameter(bias, bias_gradient, "bias");
 
 		reset_parameters();
 	}
@@ -36,19 +47,64 @@ public:
 		set_uniform<OptimizerT, float>(bias.get_optimizer(), -bound, bound);
 	}
 
+	// The output is computed in the memory of storage if it is large enough (see Sequential)
 	template <typename OtherT>
-	StdTensor<ForwardT> forward(StdTensor<OtherT> const& x) {
-		input = x;
-		return matmul_row_add<ForwardT::nbits, ForwardT::es>(x, weight.get_forward(), bias.get_forward());
+	StdTensor<ForwardT> forward(StdTensor<OtherT> const& x, StdTensor<ForwardT> storage=StdTensor<ForwardT>()) {
+		PROFILE_SCOPE("forward", x);
+		bool const save = this->save_for_backward();
+
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		if(save)
+			input = x;
+		else
+			input = StdTensor<GradientT>();
+
+		StdTensor<ForwardT> y = matmul_row_add<ForwardT::nbits, ForwardT::es>(x, weight.get_forward(), bias.get_forward(), activation, std::move(storage));
+
+		// ReLU only needs which outputs were zeroed, Sigmoid and Tanh need the outputs
+		if(activation == Activation::relu && save)
+			set_zero_mask(y);
+		else
+			zero.resize(0);
+
+		if(activation != Activation::none && activation != Activation::relu && save)
+			output = y;
+		else
+			output = StdTensor<BackwardT>();
+
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> shape) const {
+		shape.back() = out_features;
+		return shape;
 	}
 
 	template <typename OtherT>
 	StdTensor<BackwardT> backward(StdTensor<OtherT> const& delta) {
+		PROFILE_SCOPE("backward", delta);
+		bool const saved = (activation == Activation::relu) ? zero.size() == delta.size() :
+							(activation == Activation::none) || output.size() == delta.size();
+		if(input.empty() || !saved)
+			throw std::logic_error( "backward of Linear needs a forward in training with gradient enabled" );
+
+		if(activation != Activation::none) {
+			StdTensor<BackwardT> const delta_activation = activation_backward(delta);
+			gradient(delta_activation);
+			StdTensor<BackwardT> deltaN = matmul<BackwardT::nbits, BackwardT::es>(delta_activation, weight.get_backward());
+			PROFILE_OUTPUT(deltaN);
+			return deltaN;
+		}
+
 		gradient(delta);
-		return matmul<BackwardT::nbits, BackwardT::es>(delta, weight.get_backward());
+		StdTensor<BackwardT> deltaN = matmul<BackwardT::nbits, BackwardT::es>(delta, weight.get_backward());
+		PROFILE_OUTPUT(deltaN);
+		return deltaN;
 	}
 
 	void gradient(StdTensor<GradientT> const& delta) {
+		PROFILE_SCOPE("gradient", delta);
 		StdTensor<GradientT> temp_weight_gradient = matmul_col(delta, input);
 		StdTensor<GradientT> temp_bias_gradient = delta;
 
@@ -67,11 +123,72 @@ public:
 	}
 
 private:
+	// Mask of the outputs zeroed by the ReLU (only zero if they were negative or zero), as in the ReLU layer
+	void set_zero_mask(StdTensor<ForwardT> const& y) {
+		size_t const size = y.size();
+		zero.resize(size);
+
+		for(size_t w=0, n_words=zero.n_words(); w<n_words; w++) {
+			size_t const begin = w*BitMask::word_bits;
+			size_t const end = (begin+BitMask::word_bits < size) ? begin+BitMask::word_bits : size;
+			uint64_t bits = 0;
+
+			for(size_t i=begin; i<end; i++) {
+				if(y[i].iszero())
+					bits |= uint64_t(1) << (i-begin);
+			}
+
+			zero.set_word(w, bits);
+		}
+	}
+
+	// Delta multiplied by the derivative of the activation, as in ReLU, Sigmoid and Tanh
+	template <typename OtherT>
+	StdTensor<BackwardT> activation_backward(StdTensor<OtherT> const& delta) const {
+		StdTensor<BackwardT> delta_activation = delta;
+
+		if(activation == Activation::relu) {
+			// Only visit the zeroed entries of each word
+			for(size_t w=0, n_words=zero.n_words(); w<n_words; w++) {
+				uint64_t bits = zero.word(w);
+
+				for(size_t i=w*BitMask::word_bits; bits!=0; bits>>=1, i++) {
+					if(bits & 1)
+						delta_activation[i].setzero();
+				}
+			}
+
+			return delta_activation;
+		}
+
+		BackwardT const pOne(1);
+
+		for(size_t i=0, size=delta_activation.size(); i<size; i++) {
+			BackwardT dx;
+			if(activation == Activation::sigmoid)
+				convert(fam_corrected(pOne, -output[i], output[i]), dx);
+			else
+				convert(fma(output[i], -output[i], pOne), dx);
+
+			delta_activation[i] = dx * delta_activation[i];
+		}
+
+		COUNT_OPS(BackwardT, OP_FUSED, delta_activation.size());
+		COUNT_OPS(BackwardT, OP_MUL, delta_activation.size());
+
+		return delta_activation;
+	}
+
 	MixedTensor<OptimizerT, ForwardT, BackwardT> weight;
 	MixedTensor<OptimizerT, ForwardT> bias;
 	StdTensor<GradientT> input;
 	StdTensor<OptimizerT> weight_gradient;
 	StdTensor<OptimizerT> bias_gradient;
+	Activation activation;
+	size_t out_features;
+	StdTensor<BackwardT> output;	// after the activation (Sigmoid and Tanh)
+	BitMask zero;	// outputs zeroed by the ReLU
+	PROFILE_NAME("Linear")
 };
 
 #endif /* LINEAR_HPP */
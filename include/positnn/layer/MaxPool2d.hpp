@@ -2,18 +2,25 @@
 #define MAXPOOL2D_HPP
 
 // General headers
+#include <cstdint>
+#include <stdexcept>
 #include <universal/posit/posit>
+#include <utility>
+#include <vector>
 
 // Custom headers
 //#include "Layer.hpp"
+#include "../tensor/channels_last.hpp"
 #include "../tensor/maximumpool.hpp"
 #include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
 template <typename ForwardT, typename BackwardT=ForwardT>
-class MaxPool2d {
+class MaxPool2d : public BackwardState {
 //class MaxPool2d : public Layer<Posit> {
 public:
 	MaxPool2d(size_t _kernel_size, size_t _stride=0, size_t _padding=0) :
@@ -23,22 +30,79 @@ public:
 		stride = (_stride==0) ? _kernel_size : _stride;
 	}
 
-	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x) {
-		input_shape = x.shape();
-		return maximumpool2d(x, kernel_size, stride, padding, &max_idx, &w);
+	// Layout of the input and output (see Layout)
+	void set_layout(Layout const _layout) {
+		layout = _layout;
+		w = NULL;
+	}
+
+	// The output is computed in the memory of storage if it is large enough (see Sequential)
+	StdTensor<ForwardT> forward(StdTensor<ForwardT> const& x, StdTensor<ForwardT> storage=StdTensor<ForwardT>()) {
+		PROFILE_SCOPE("forward", x);
+
+		// The window is only looked up again if the shape of the input changes
+		if(w == NULL || x.shape() != input_shape) {
+			input_shape = x.shape();
+			w = (layout == Layout::channels_last) ?
+				&pool2d_window(channels_first_shape(input_shape), kernel_size, stride, padding) :
+				&pool2d_window(input_shape, kernel_size, stride, padding);
+		}
+
+		StdTensor<ForwardT> y = (maxpool2d_byte_offsets(kernel_size)) ?
+			pool(x, max_offset, std::move(storage)) :
+			pool(x, large_max_offset, std::move(storage));
+		PROFILE_OUTPUT(y);
+		return y;
+	}
+
+	std::vector<size_t> output_shape(std::vector<size_t> const& shape) const {
+		return window2d_output_shape(shape, layout, 0, kernel_size, stride, padding);
 	}
 
 	StdTensor<BackwardT> backward(StdTensor<BackwardT> const& deltaN) {
-		return maximumpool2d_backward(deltaN, input_shape, kernel_size, stride, max_idx);
+		PROFILE_SCOPE("backward", deltaN);
+		StdTensor<BackwardT> delta = (maxpool2d_byte_offsets(kernel_size)) ?
+			unpool(deltaN, max_offset) :
+			unpool(deltaN, large_max_offset);
+		PROFILE_OUTPUT(delta);
+		return delta;
 	}
 
 private:
+	template <typename Offset>
+	StdTensor<ForwardT> pool(StdTensor<ForwardT> const& x, std::vector<Offset>& offsets, StdTensor<ForwardT> storage) {
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		std::vector<Offset>* save = NULL;
+		if(save_for_backward())
+			save = &offsets;
+		else
+			offsets.clear();
+
+		if(layout == Layout::channels_last)
+			return maximumpool2d_channels_last(x, kernel_size, stride, padding, save, w);
+
+		return maximumpool2d(x, kernel_size, stride, padding, save, w, std::move(storage));
+	}
+
+	template <typename Offset>
+	StdTensor<BackwardT> unpool(StdTensor<BackwardT> const& deltaN, std::vector<Offset> const& offsets) const {
+		if(offsets.size() != deltaN.size())
+			throw std::logic_error( "backward of MaxPool2d needs a forward in training with gradient enabled" );
+
+		return (layout == Layout::channels_last) ?
+			maximumpool2d_backward_channels_last(deltaN, input_shape, kernel_size, stride, padding, offsets, *w) :
+			maximumpool2d_backward(deltaN, input_shape, kernel_size, stride, offsets, *w);
+	}
+
 	size_t kernel_size;
 	size_t stride;
 	size_t padding;
 	std::vector<size_t> input_shape;
-	Window w;
-	std::vector<size_t> max_idx;
+	Window const* w = NULL;	// shared, see shared_window
+	std::vector<uint8_t> max_offset;	// of the maximums in their windows
+	std::vector<size_t> large_max_offset;	// same, if they don't fit in 1 byte (see maxpool2d_byte_offsets)
+	Layout layout = Layout::channels_first;
+	PROFILE_NAME("MaxPool2d")
 };
 
 #endif /* MAXPOOL2D_HPP */
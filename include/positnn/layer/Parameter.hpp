@@ -2,6 +2,7 @@
 #define PARAMETER_HPP
 
 // General headers
+#include <string>
 #include <vector>
 
 // Custom headers
@@ -10,17 +11,19 @@
 
 template <typename T>
 struct Parameter {
-	Parameter(StdTensor<T>& _weight, StdTensor<T>& _gradient) :
+	Parameter(StdTensor<T>& _weight, StdTensor<T>& _gradient, std::string const& _name="") :
 		weight(_weight),
 		gradient(_gradient),
-		mixed_tensor(nullptr)
+		mixed_tensor(nullptr),
+		name(_name)
 	{ }
 
 	template <typename ForwardT, typename BackwardT>
-	Parameter(MixedTensor<T, ForwardT, BackwardT>& _weight, StdTensor<T>& _gradient) :
+	Parameter(MixedTensor<T, ForwardT, BackwardT>& _weight, StdTensor<T>& _gradient, std::string const& _name="") :
 		weight(_weight.get_optimizer()),
 		gradient(_gradient),
-		mixed_tensor(static_cast<TensorUpdater*>(&_weight))
+		mixed_tensor(static_cast<TensorUpdater*>(&_weight)),
+		name(_name)
 	{ }
 
 	void update() {
@@ -36,6 +39,21 @@ struct Parameter {
 	StdTensor<T>& weight;
 	StdTensor<T>& gradient;
 	TensorUpdater* mixed_tensor;
+	std::string name;	// e.g. "0.weight" (module index and parameter name)
+};
+
+// State of a layer that is saved with the model but isn't optimized (e.g. running stats of batch norms)
+template <typename T>
+struct Buffer {
+	Buffer(StdTensor<T>& _tensor, std::string const& _name="", bool const _module=false) :
+		tensor(_tensor),
+		name(_name),
+		module(_module)
+	{ }
+
+	StdTensor<T>& tensor;
+	std::string name;	// e.g. "1.running_mean" (module index and buffer name)
+	bool module;	// registered through a module (not saved before POSIT_FILE_VERSION 3)
 };
 
 /*
@@ -2,6 +2,7 @@
 #define RANGEBATCHNORM1D_HPP
 
 // General headers
+#include <stdexcept>
 #include <universal/posit/posit>
 
 // Custom headers
@@ -10,6 +11,7 @@
 #include "../tensor/sum.hpp"
 #include "../tensor/StdTensor.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -33,8 +35,10 @@ public:
 			running_scale = StdTensor<Posit>(num_features);
 		}
 
-		this->register_parameter(gamma, gamma_gradient);
-		this->register_parameter(beta, beta_gradient);
+		this->register_parameter(gamma, gamma_gradient, "weight");
+		this->register_parameter(beta, beta_gradient, "bias");
+		this->register_buffer(running_mean, "running_mean");
+		this->register_buffer(running_scale, "running_scale");
 
 		reset_parameters();
 	}
@@ -49,10 +53,16 @@ public:
 	}
 
 	StdTensor<Posit> forward(StdTensor<Posit> x) {
+		PROFILE_SCOPE("forward", x);
 		size_t const batch_size = x.shape()[0];
 
 		C_1 = sqrt(2*log(Posit(batch_size)));
 
+		// Without saving, clear what a previous forward saved, so backward can't use it
+		bool const save = Layer<Posit>::save_for_backward();
+		if(!save)
+			x_norm = StdTensor<Posit>();
+
 		if(Layer<Posit>::training || !track_running_stats) {
 			// calculate mean and range
 			StdTensor<Posit> mean = calculate_mean(x);
@@ -63,7 +73,8 @@ public:
 
 			// calculate scale and normalize
 			normalize(x, range);
-			x_norm = x;
+			if(save)
+				x_norm = x;
 
 			if(track_running_stats) {
 				// update running mean and scale
@@ -82,10 +93,15 @@ public:
 			x += beta;
 		}
 
+		PROFILE_OUTPUT(x);
 		return x;
 	}
 
 	StdTensor<Posit> backward(StdTensor<Posit> delta) {
+		PROFILE_SCOPE("backward", delta);
+		if(x_norm.size() != delta.size())
+			throw std::logic_error( "backward of RangeBatchNorm1d needs a forward in training with gradient enabled" );
+
 		if(affine)
 			gradient(delta);
 
@@ -116,10 +132,12 @@ public:
 
 		delta_1 /= scale;
 
+		PROFILE_OUTPUT(delta_1);
 		return delta_1;
 	}
 
 	void gradient(StdTensor<Posit> delta) {
+		PROFILE_SCOPE("gradient", delta);
 		StdTensor<Posit> temp_beta_gradient = sum_first(delta);
 
 		//delta *= x_norm;
@@ -175,8 +193,8 @@ public:
 
 		// Calculate range
 		for(size_t i=0, j=0; i<num_features; i++, j+=batch_size){
-			max[i] = *std::max_element(begin+j, begin+j+num_features);
-			min[i] = *std::min_element(begin+j, begin+j+num_features);
+			max[i] = *std::max_element(begin+j, begin+j+num_features, OrdinalLess());
+			min[i] = *std::min_element(begin+j, begin+j+num_features, OrdinalLess());
 			range[i] = max[i] - min[i];
 		}
 
@@ -233,20 +251,6 @@ public:
 		fused(running_scale, scale, 1-momentum, momentum);
 	}
 
-	template <typename PositFile=Posit>
-void write(std::ostream& out) {
-	Layer<Posit>::write(out);	
-		running_mean.template write<PositFile>(out);
-		running_scale.template write<PositFile>(out);
-	}
-
-	template <typename PositFile=Posit>
-	void read(std::istream& in) {
-		Layer<Posit>::read(in);	
-		running_mean.template read<PositFile>(in);
-		running_scale.template read<PositFile>(in);
-	}
-
 private:
 	size_t const num_features;
 	Posit eps;
@@ -268,6 +272,7 @@ private:
 	std::vector<size_t> min_size;
 	StdTensor<Posit> x_norm;
 	Posit C_1;
+	PROFILE_NAME("RangeBatchNorm1d")
 };
 
 #endif /* RANGEBATCHNORM1D_HPP */
@@ -0,0 +1,364 @@
+#ifndef SEQUENTIAL_HPP
+#define SEQUENTIAL_HPP
+
+// General headers
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Custom headers
+#include "BatchNorm2d.hpp"
+#include "Layer.hpp"
+#include "../tensor/channels_last.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "../utils/GradMode.hpp"
+
+// Chain of layers (e.g. Conv2d, ReLU, MaxPool2d, Flatten, Linear) owned by the container
+// Each activation is moved into the next layer (layers that take their input by value, like ReLU,
+// reuse its storage for the output). The outputs of the other layers that take a storage
+// (Linear, Conv2d, Conv2dMaxPool2dReLU and MaxPool2d) are computed in buffers planned from the
+// shapes of the activations, which are recycled once the next layer used them, so forward only
+// allocates the returned output and what layers keep for backward
+// Layers with parameters are registered as modules, named like register_module does
+template <typename OptimizerT, typename ForwardT=OptimizerT, typename BackwardT=ForwardT>
+class Sequential : public Layer<OptimizerT> {
+public:
+	Sequential() { }
+
+	Sequential(Sequential const&) = delete;
+	Sequential& operator=(Sequential const&) = delete;
+
+	// Construct a layer at the end of the chain
+	template <typename Module, typename... Args>
+	Module& add(Args&&... args) {
+		return add_named<Module>("", std::forward<Args>(args)...);
+	}
+
+	template <typename Module, typename... Args>
+	Module& add_named(std::string name, Args&&... args) {
+		// Layers register pointers to their parameters, so they can't be moved after construction
+		Module* module = new Module(std::forward<Args>(args)...);
+		steps.emplace_back(new Step<Module>(module));
+
+		if(name.empty())
+			name = register_layer(*module, std::is_base_of<Layer<OptimizerT>, Module>());
+		else
+			register_layer(*module, name, std::is_base_of<Layer<OptimizerT>, Module>());
+
+		register_state(*module, std::is_base_of<BackwardState, Module>());
+
+		names.push_back(name);
+		output_shapes.clear();
+
+		return *module;
+	}
+
+	size_t size() const {
+		return steps.size();
+	}
+
+	// Layout of the activations of the layers that have one (e.g. Conv2d, MaxPool2d, Flatten)
+	// With channels last, the input has to be converted once, with to_channels_last
+	void set_layout(Layout const layout) {
+		for(std::unique_ptr<StepBase>& step : steps)
+			step->set_layout(layout);
+
+		output_shapes.clear();
+	}
+
+	// Fold each BatchNorm2d into the layer before it if it is a convolution (e.g. Conv2d),
+	// so the batch norm is computed by the convolution (see BatchNorm2d::fold_into)
+	// This is only for inference: train and save the model before, since its parameters are changed
+	// Returns the number of folded batch norms
+	size_t fold_batchnorm() {
+		size_t folded = 0;
+
+		for(size_t i=1; i<steps.size(); i++) {
+			BatchNorm2d<OptimizerT>* batchnorm = steps[i]->batchnorm();
+			if(batchnorm != NULL && !batchnorm->is_folded() && steps[i-1]->fold(*batchnorm))
+				folded++;
+		}
+
+		return folded;
+	}
+
+	StdTensor<ForwardT> forward(StdTensor<ForwardT> x) {
+		plan(x.shape());
+
+		for(std::unique_ptr<StepBase>& step : steps) {
+			StdTensor<ForwardT> storage = take_buffer();
+			StdTensor<ForwardT> y = step->forward(std::move(x), storage);
+
+			// Storage not used by the layer and its input (unless it was moved into the layer) are free again
+			give_buffer(std::move(storage));
+			give_buffer(std::move(x));
+			x = std::move(y);
+		}
+
+		return x;
+	}
+
+	StdTensor<BackwardT> backward(StdTensor<BackwardT> delta) {
+		for(size_t i=steps.size(); i-->0; )
+			delta = steps[i]->backward(std::move(delta));
+
+		return delta;
+	}
+
+	// Shapes of the outputs of each layer for an input with input_shape
+	// Computed from the output_shape of the layers that change it (e.g. Conv2d, MaxPool2d, Flatten, Linear),
+	// without running them, so the layers and what they keep for backward aren't changed
+	std::vector<std::vector<size_t>> const& shapes(std::vector<size_t> const& input_shape) {
+		if(input_shape == planned_shape && output_shapes.size() == steps.size())
+			return output_shapes;
+
+		std::vector<size_t> shape = input_shape;
+
+		output_shapes.clear();
+		for(std::unique_ptr<StepBase>& step : steps) {
+			shape = step->output_shape(shape);
+			output_shapes.push_back(shape);
+		}
+
+		planned_shape = input_shape;
+
+		return output_shapes;
+	}
+
+	// Largest memory of activations alive at the same time in forward (input and output of a layer)
+	// Upper bound, since layers like Flatten and ReLU reuse the storage of their input
+	size_t peak_activation_bytes(std::vector<size_t> const& input_shape) {
+		std::vector<std::vector<size_t>> const& s = shapes(input_shape);
+		size_t peak = 0;
+		size_t previous = elements(input_shape) * sizeof(ForwardT);
+
+		for(std::vector<size_t> const& shape : s) {
+			size_t const bytes = elements(shape) * sizeof(ForwardT);
+			if(previous + bytes > peak)
+				peak = previous + bytes;
+			previous = bytes;
+		}
+
+		return peak;
+	}
+
+	// Print output shape and size of each layer
+	void summary(std::vector<size_t> const& input_shape, std::ostream& out=std::cout) {
+		std::vector<std::vector<size_t>> const& s = shapes(input_shape);
+
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-6s %-12s %-24s %12s %12s", "Layer", "Name", "Output shape", "Elements", "Bytes");
+		out << line << std::endl;
+
+		for(size_t i=0; i<s.size(); i++) {
+			std::string shape;
+			for(size_t j=0; j<s[i].size(); j++)
+				shape += ((j>0) ? "x" : "") + std::to_string(s[i][j]);
+
+			size_t const n = elements(s[i]);
+			std::snprintf(line, sizeof(line), "%-6zu %-12s %-24s %12zu %12zu",
+							i, names[i].c_str(), shape.c_str(), n, n*sizeof(ForwardT));
+			out << line << std::endl;
+		}
+
+		out << "Peak of activations in forward: " << peak_activation_bytes(input_shape) << " bytes" << std::endl;
+	}
+
+private:
+	struct StepBase {
+		virtual ~StepBase() { }
+		virtual StdTensor<ForwardT> forward(StdTensor<ForwardT>&& x, StdTensor<ForwardT>& storage) = 0;
+		virtual std::vector<size_t> output_shape(std::vector<size_t> const& shape) const = 0;
+		virtual StdTensor<BackwardT> backward(StdTensor<BackwardT>&& delta) = 0;
+		virtual void set_layout(Layout const layout) = 0;
+		virtual BatchNorm2d<OptimizerT>* batchnorm() = 0;
+		virtual bool fold(BatchNorm2d<OptimizerT>& batchnorm) = 0;
+	};
+
+	template <typename Module>
+	struct Step : StepBase {
+		explicit Step(Module* _module) :
+			module(_module)
+		{ }
+
+		StdTensor<ForwardT> forward(StdTensor<ForwardT>&& x, StdTensor<ForwardT>& storage) override {
+			return call_forward_into(*module, x, storage, 0);
+		}
+
+		std::vector<size_t> output_shape(std::vector<size_t> const& shape) const override {
+			return call_output_shape(*module, shape, 0);
+		}
+
+		StdTensor<BackwardT> backward(StdTensor<BackwardT>&& delta) override {
+			return call_backward(*module, delta, 0);
+		}
+
+		void set_layout(Layout const layout) override {
+			call_set_layout(*module, layout, 0);
+		}
+
+		BatchNorm2d<OptimizerT>* batchnorm() override {
+			return as_batchnorm(*module);
+		}
+
+		bool fold(BatchNorm2d<OptimizerT>& batchnorm) override {
+			return call_fold(*module, batchnorm, 0);
+		}
+
+		std::unique_ptr<Module> module;
+	};
+
+	// Move the tensor into the layer if it takes it by value or const reference,
+	// otherwise pass it by reference (e.g. Dropout)
+	template <typename Module, typename T>
+	static auto call_forward(Module& module, StdTensor<T>& x, int) -> decltype(module.forward(std::move(x))) {
+		return module.forward(std::move(x));
+	}
+
+	template <typename Module, typename T>
+	static auto call_forward(Module& module, StdTensor<T>& x, long) -> decltype(module.forward(x)) {
+		return module.forward(x);
+	}
+
+	// Compute the output in storage if the layer takes one (e.g. Linear), otherwise leave it as it is
+	template <typename Module, typename T>
+	static auto call_forward_into(Module& module, StdTensor<T>& x, StdTensor<T>& storage, int) -> decltype(module.forward(x, std::move(storage))) {
+		return module.forward(x, std::move(storage));
+	}
+
+	template <typename Module, typename T>
+	static auto call_forward_into(Module& module, StdTensor<T>& x, StdTensor<T>&, long) -> decltype(call_forward(module, x, 0)) {
+		return call_forward(module, x, 0);
+	}
+
+	template <typename Module, typename T>
+	static auto call_backward(Module& module, StdTensor<T>& delta, int) -> decltype(module.backward(std::move(delta))) {
+		return module.backward(std::move(delta));
+	}
+
+	template <typename Module, typename T>
+	static auto call_backward(Module& module, StdTensor<T>& delta, long) -> decltype(module.backward(delta)) {
+		return module.backward(delta);
+	}
+
+	// Layers without output_shape (e.g. ReLU, BatchNorm2d, Dropout) keep the shape of their input
+	template <typename Module>
+	static auto call_output_shape(Module const& module, std::vector<size_t> const& shape, int) -> decltype(module.output_shape(shape)) {
+		return module.output_shape(shape);
+	}
+
+	template <typename Module>
+	static std::vector<size_t> call_output_shape(Module const&, std::vector<size_t> const& shape, long) {
+		return shape;
+	}
+
+	// Layers without layout (e.g. ReLU, Linear) are the same for both
+	template <typename Module>
+	static auto call_set_layout(Module& module, Layout const layout, int) -> decltype(module.set_layout(layout)) {
+		return module.set_layout(layout);
+	}
+
+	template <typename Module>
+	static void call_set_layout(Module&, Layout const, long) { }
+
+	static BatchNorm2d<OptimizerT>* as_batchnorm(BatchNorm2d<OptimizerT>& module) {
+		return &module;
+	}
+
+	template <typename Module>
+	static BatchNorm2d<OptimizerT>* as_batchnorm(Module&) {
+		return NULL;
+	}
+
+	// Only layers that can scale and shift their output channels (e.g. Conv2d) take a batch norm
+	template <typename Module>
+	static auto call_fold(Module& module, BatchNorm2d<OptimizerT>& batchnorm, int)
+		-> decltype(module.scale_shift_output(std::declval<StdTensor<OptimizerT> const&>(), std::declval<StdTensor<OptimizerT> const&>()), bool()) {
+		batchnorm.fold_into(module);
+		return true;
+	}
+
+	template <typename Module>
+	static bool call_fold(Module&, BatchNorm2d<OptimizerT>&, long) {
+		return false;
+	}
+
+	std::string register_layer(Layer<OptimizerT>& layer, std::true_type) {
+		std::string const name = std::to_string(this->modules.size());
+		this->register_module(layer, name);
+		return name;
+	}
+
+	template <typename Module>
+	std::string register_layer(Module&, std::false_type) {
+		return "#" + std::to_string(steps.size()-1);
+	}
+
+	void register_layer(Layer<OptimizerT>& layer, std::string const& name, std::true_type) {
+		this->register_module(layer, name);
+	}
+
+	template <typename Module>
+	void register_layer(Module&, std::string const&, std::false_type) { }
+
+	// Modules without parameters that keep state for backward (e.g. ReLU), so eval() reaches them
+	void register_state(BackwardState& module, std::true_type) {
+		this->register_module(module);
+	}
+
+	template <typename Module>
+	void register_state(Module&, std::false_type) { }
+
+	// Buffers for the outputs of the layers: one for the output and one for the input that is still used
+	// Each one is allocated for the largest activation, so the layers don't have to allocate their outputs
+	void plan(std::vector<size_t> const& input_shape) {
+		std::vector<std::vector<size_t>> const& s = shapes(input_shape);
+
+		planned_elements = 0;
+		for(std::vector<size_t> const& shape : s)
+			if(elements(shape) > planned_elements)
+				planned_elements = elements(shape);
+
+		for(StdTensor<ForwardT>& buffer : buffers)
+			if(buffer.capacity() < planned_elements)
+				buffer.reuse({planned_elements});
+
+		while(buffers.size() < 2)
+			buffers.emplace_back(std::vector<size_t>{planned_elements});
+	}
+
+	StdTensor<ForwardT> take_buffer() {
+		if(buffers.empty())
+			return StdTensor<ForwardT>();
+
+		StdTensor<ForwardT> buffer = std::move(buffers.back());
+		buffers.pop_back();
+		return buffer;
+	}
+
+	// Only keeps tensors as large as the plan (e.g. not the input of the model or the moved ones)
+	void give_buffer(StdTensor<ForwardT>&& buffer) {
+		if(buffers.size() < 2 && buffer.capacity() >= planned_elements && buffer.capacity() > 0)
+			buffers.push_back(std::move(buffer));
+	}
+
+	static size_t elements(std::vector<size_t> const& shape) {
+		size_t n = 1;
+		for(size_t const s : shape)
+			n *= s;
+		return n;
+	}
+
+	std::vector<std::unique_ptr<StepBase>> steps;
+	std::vector<std::string> names;
+	std::vector<size_t> planned_shape;
+	std::vector<std::vector<size_t>> output_shapes;
+	size_t planned_elements = 0;
+	std::vector<StdTensor<ForwardT>> buffers;
+};
+
+#endif /* SEQUENTIAL_HPP */
@@ -1,62 +1,155 @@
 #ifndef CROSSENTROPYLOSS_HPP
 #define CROSSENTROPYLOSS_HPP
 
+#ifdef LL_THREADS
+	#if LL_THREADS>1
+		#define USING_LL_THREADS
+	#endif
+#endif /* LL_THREADS */
+
+// General headers
+#include <algorithm>
+#include <stdexcept>
+#ifdef USING_LL_THREADS
+#include <thread>
+#endif /* USING_LL_THREADS */
+#include <vector>
+
 // Custom headers
 #include "Loss.hpp"
 #include "../tensor/StdTensor.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/GradMode.hpp"
+#include "../utils/Profiler.hpp"
+#include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
+// Softmax and cross entropy of some samples (rows of output), each one in a single pass
+// The loss of each sample goes to sample_loss and, if gradient is true, the derivative
+// of the loss w.r.t. output goes to dloss (after the row is used to keep exp(x-max))
+template <class ForwardT, class BackwardT, class TargetT, typename lossT>
+void softmax_cross_entropy_thread(	StdTensor<ForwardT> const& output, StdTensor<TargetT> const& target,
+									StdTensor<BackwardT>& dloss, std::vector<lossT>& sample_loss,
+									size_t const begin, size_t const end, bool const gradient	){
+
+	size_t const sample_size = output.shape()[1];
+
+	typename StdTensor<ForwardT>::const_iterator const output_begin = output.begin();
+	Quire<ForwardT::nbits, ForwardT::es> q;
+	ForwardT sum_forward;
+	value<2 * (BackwardT::nbits + 3 - BackwardT::es)> result;
+
+	for(size_t i=begin, j=begin*sample_size; i<end; i++, j+=sample_size) {
+		ForwardT const& max = *std::max_element(output_begin+j, output_begin+j+sample_size, OrdinalLess());
+
+		q.clear();
+		for(size_t k=0; k<sample_size; k++) {
+			ForwardT const exp_x_max_forward = exp(output[j+k] - max);
+			q += exp_x_max_forward;
+
+			// Keep in dloss to be used below
+			if(gradient)
+				dloss[j+k] = exp_x_max_forward;
+		}
+		convert(q.to_value(), sum_forward);
+
+		size_t const index = target[i];
+		ForwardT const log_softmax = output[j+index] - max - log(sum_forward);
+		sample_loss[i] = lossT( log_softmax );
+
+		if(!gradient)
+			continue;
+
+		// Calculate softmax and subtract 1 to the target class (fam has the best results)
+		BackwardT const sum(sum_forward);
+		BackwardT const sub(-sum);
+		BackwardT const den = sum.reciprocate();
+
+		for(size_t k=0; k<sample_size; k++) {
+			if(k==index) {
+				result = fam_corrected(dloss[j+k], sub, den);
+				convert(result, dloss[j+k]);
+			}
+			else {
+				dloss[j+k] = dloss[j+k]/sum;
+			}
+		}
+	}
+
+	COUNT_OPS(ForwardT, OP_EXP_LOG, (end-begin)*(sample_size+1));
+
+	if(gradient) {
+		COUNT_OPS(BackwardT, OP_FUSED, end-begin);
+		COUNT_OPS(BackwardT, OP_DIV, (end-begin)*(sample_size-1));
+	}
+}
+
 template <class ForwardT, class BackwardT=ForwardT, class TargetT=unsigned short int, typename lossT=float>
 class cross_entropy_loss : public Loss<BackwardT, lossT>{
 public:
 	cross_entropy_loss() { }
 
-	cross_entropy_loss(StdTensor<ForwardT> const& output, StdTensor<TargetT> const& _target, Reduction reduction=Reduction::Mean) :
-		exp_x_max(output.shape()),
-		sum(output.shape()[0]),
-		target(_target)
+	// The derivative is computed together with the loss, unless gradient is false
+	// (by default, with a NoGradGuard)
+	cross_entropy_loss(StdTensor<ForwardT> const& output, StdTensor<TargetT> const& target,
+						Reduction reduction=Reduction::Mean, bool const gradient=GradMode::is_enabled())
 	{
+		PROFILE_SCOPE_NAMED("CrossEntropyLoss", "forward", output);
 		// TODO: protect if target is not integer
 		const size_t batch_size = output.shape()[0];
-		const size_t sample_size = output.shape()[1];
 
-		typename StdTensor<ForwardT>::const_iterator const output_begin = output.begin();
-		Quire<ForwardT::nbits, ForwardT::es> q;
-		ForwardT sum_forward;
+		if(gradient)
+			dloss = StdTensor<BackwardT>(output.shape());
 
-		for(size_t i=0, j=0; i<batch_size; i++, j+=sample_size) {
-			ForwardT const& max = *std::max_element(output_begin+j, output_begin+j+sample_size);
+		std::vector<lossT> sample_loss(batch_size);
 
-			q.clear();
-			for(size_t k=0; k<sample_size; k++) {
-				ForwardT const exp_x_max_forward = exp(output[j+k] - max);
-				q += exp_x_max_forward;
+#ifndef USING_LL_THREADS
+		softmax_cross_entropy_thread<ForwardT, BackwardT, TargetT, lossT>(	output, target, dloss, sample_loss,
+																			0, batch_size, gradient	);
+#else
+		// Distribute threads (each thread will take care of the same # of samples)
+		const size_t max_threads = (LL_THREADS<batch_size) ? LL_THREADS : batch_size;
+		std::vector<std::thread> threads;
+		threads.reserve(max_threads);
 
-				// Copy to be used in backward
-				exp_x_max[j+k] = exp_x_max_forward;
-			}
-			convert(q.to_value(), sum_forward);
+		// Calculate load for each thread
+		size_t const n_samples = (max_threads>0) ? batch_size / max_threads : 0;
+		size_t const nthreads_more = (max_threads>0) ? batch_size % max_threads : 0;
 
-			// Copy to be used in backward
-			sum[i] = sum_forward;
+		size_t begin = 0;
 
-			ForwardT const log_softmax = output[j+target[i]] - max - log(sum_forward);
+		for(size_t t=0; t<max_threads; t++){
+			size_t const end = begin + ((t<nthreads_more) ? n_samples+1 : n_samples);
 
-			this->loss -= lossT( log_softmax );
+			threads.push_back(std::thread(softmax_cross_entropy_thread<ForwardT, BackwardT, TargetT, lossT>,
+											std::cref(output), std::cref(target), std::ref(dloss), std::ref(sample_loss),
+											begin, end, gradient	));
+
+			begin = end;
+		}
+
+		for(std::thread& t : threads) {
+			t.join();
 		}
+#endif /* USING_LL_THREADS */
+
+		// Sum in order, so the result doesn't depend on the # of threads
+		for(lossT const& l : sample_loss)
+			this->loss -= l;
 
 		if(reduction == Reduction::Mean)
 			this->loss /= batch_size;
 	}	
 
 	StdTensor<BackwardT> derivative() override {
-		size_t const batch_size = exp_x_max.shape()[0];
-		size_t const sample_size = exp_x_max.shape()[1];
+		PROFILE_SCOPE_NAMED("CrossEntropyLoss", "backward", dloss);
 
+		if(dloss.empty())
+			throw std::logic_error( "cross_entropy_loss was created without gradient" );
 
+		// Alternatives that were tried before the current one (fam):
 		// Previously used this (divide last)
 		/*
 		StdTensor<BackwardT> dloss(exp_x_max);
@@ -113,28 +206,6 @@ public:
 		}
 		*/
 
-		// This has the best results (fam)
-		StdTensor<BackwardT> dloss(exp_x_max.shape());
-		value<2 * (BackwardT::nbits + 3 - BackwardT::es)> result;
-
-		for(size_t i=0, j=0; i<batch_size; i++, j+=sample_size){
-			// Calculate softmax and subtract 1 to the target class
-			const size_t index = target[i];
-			BackwardT sub(-sum[i]);
-			//BackwardT den(1/sum[i]);
-			BackwardT den = sum[i].reciprocate();
-
-			for(size_t k=0; k<sample_size; k++) {
-				if(k==index) {
-					result = fam_corrected(exp_x_max[j+k], sub, den);
-					convert(result, dloss[j+k]);
-				}
-				else {
-					dloss[j+k] = exp_x_max[j+k]/sum[i];
-				}
-			}
-		}
-
 		// This should have better results than fma (fma improved)
 		/*
 		StdTensor<BackwardT> dloss(exp_x_max.shape());
@@ -163,13 +234,12 @@ public:
 		}
 		*/
 
+		PROFILE_OUTPUT(dloss);
 		return dloss;
 	}
 
 private:
-	StdTensor<BackwardT> exp_x_max;
-	StdTensor<BackwardT> sum;
-	StdTensor<TargetT> target;
+	StdTensor<BackwardT> dloss;
 };
 
 #endif /* CROSSENTROPYLOSS_HPP */
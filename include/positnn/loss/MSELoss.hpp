@@ -3,6 +3,7 @@
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -15,6 +16,7 @@ public:
 	mse_loss(StdTensor<ForwardT> const& output, StdTensor<ForwardT> const& target, Reduction reduction=Reduction::Mean) :
 		error(output.shape())
 	{
+		PROFILE_SCOPE_NAMED("MSELoss", "forward", output);
 		size_t const size = output.size();
 
 		if(size != target.size())
@@ -34,6 +36,7 @@ public:
 	}
 
 	StdTensor<BackwardT> derivative() {
+		PROFILE_SCOPE_NAMED("MSELoss", "backward", error);
 		StdTensor<BackwardT> dloss = error * 2;
 
 		/*
@@ -44,6 +47,7 @@ public:
 		}
 		*/
 
+		PROFILE_OUTPUT(dloss);
 		return dloss;
 	}
 
@@ -3,6 +3,7 @@
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
+#include "../utils/Profiler.hpp"
 
 // Namespaces
 using namespace sw::unum;
@@ -16,6 +17,7 @@ public:
 		output_shape(output.shape()),
 		target(target)
 	{
+		PROFILE_SCOPE_NAMED("NLLLoss", "forward", output);
 		// TODO: protect if target is not integer
 		size_t const rows = output_shape[0];
 		size_t const cols = output_shape[1];
@@ -34,6 +36,7 @@ public:
 
 	StdTensor<T> derivative() {
 		StdTensor<T> dloss(output_shape);
+		PROFILE_SCOPE_NAMED("NLLLoss", "backward", dloss);
 		T minusOne(-1);
 
 		size_t const rows = output_shape[0];
@@ -44,6 +47,7 @@ public:
 			dloss[j+target[i]] = minusOne;
 		}
 
+		PROFILE_OUTPUT(dloss);
 		return dloss;
 	}
 
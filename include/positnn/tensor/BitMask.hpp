@@ -0,0 +1,65 @@
+#ifndef BITMASK_HPP
+#define BITMASK_HPP
+
+// General headers
+#include <cstdint>
+#include <vector>
+
+// Mask with 1 bit per entry of a tensor (e.g. entries zeroed by ReLU or Dropout)
+// Bits are packed in 64-bit words, which are written at once, and the storage
+// is kept between calls of resize (e.g. between iterations)
+class BitMask {
+public:
+	static size_t const word_bits = 64;
+
+	BitMask() :
+		m_size(0)
+	{ }
+
+	void resize(size_t const size) {
+		m_size = size;
+		m_words.resize((size + word_bits - 1) / word_bits);
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	size_t n_words() const {
+		return m_words.size();
+	}
+
+	bool operator[](size_t const i) const {
+		return (m_words[i/word_bits] >> (i%word_bits)) & 1;
+	}
+
+	// Bits of entries [w*word_bits, (w+1)*word_bits), the first one in the least significant bit
+	uint64_t word(size_t const w) const {
+		return m_words[w];
+	}
+
+	void set_word(size_t const w, uint64_t const bits) {
+		m_words[w] = bits;
+	}
+
+	// Set each bit to f(), in order of the entries
+	template <typename Function>
+	void generate(Function f) {
+		for(size_t w=0, i=0, n=n_words(); w<n; w++) {
+			uint64_t bits = 0;
+
+			for(size_t b=0; b<word_bits && i<m_size; b++, i++) {
+				if(f())
+					bits |= uint64_t(1) << b;
+			}
+
+			m_words[w] = bits;
+		}
+	}
+
+private:
+	size_t m_size;
+	std::vector<uint64_t> m_words;
+};
+
+#endif /* BITMASK_HPP */
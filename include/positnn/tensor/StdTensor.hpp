@@ -11,6 +11,7 @@
 #include <vector>
 
 // Custom headers
+#include "../utils/OpCounter.hpp"
 #include "../utils/type_name.hpp"
 #include "../utils/utils.hpp"
 
@@ -94,6 +95,8 @@ public:
 		for(size_t i=copy_size; i<m_size; i++)
 			m_data.push_back(T(rhs[i]));
 
+		COUNT_CONVERSIONS(otherT, T, m_size);
+
 		//return *this;
 	}
 
@@ -138,6 +141,18 @@ public:
 		compute_strides();
 	}
 
+	// Same as a new tensor with new_shape, but in the memory of this one (e.g. the output of a previous
+	// forward, see Sequential), so it is only allocated if it is too small. Entries aren't reset
+	void reuse(const std::vector<size_t>& new_shape) {
+		m_size = std::accumulate(	new_shape.begin(), new_shape.end(),
+									1, std::multiplies<size_t>());
+		m_data.resize(m_size);
+
+		m_dim = new_shape.size();
+		m_shape = new_shape;
+		compute_strides();
+	}
+
 	// Get shape
 	const std::vector<size_t>& shape() const {
 		return m_shape;
@@ -197,6 +212,11 @@ public:
 		return m_data.empty();
 	}
 
+	// Entries that fit in the memory of the tensor without allocating (see reuse)
+	size_t capacity() const {
+		return m_data.capacity();
+	}
+
 	// Set tensor to zero
 	void clear() {
 		for(size_t i=0; i<m_size; i++)
@@ -254,12 +274,12 @@ public:
 
 	// Read posit from file (binary)
 	template <typename PositFile=T>
-	void read(std::istream& in) {
+	void read(std::istream& in, size_t const version=POSIT_FILE_VERSION) {
 		in.read((char*)&m_dim, sizeof(m_dim));
 		in.read((char*)&m_size, sizeof(m_size));
 		read_vector(in, m_shape);
 		read_vector(in, m_strides);
-		read_vector_posit<T, PositFile>(in, m_data);
+		read_vector_posit<T, PositFile>(in, m_data, version);
 	}
 	
 	// Print operator
@@ -280,6 +300,8 @@ public:
 			m_data[i] += other[i%other_size];	// TODO: WARN THAT B IS REPEATED
 		}
 
+		COUNT_OPS(T, OP_ADD, m_size);
+
 		return *this;
 	}
 
@@ -297,6 +319,8 @@ public:
 			m_data[i] += aux;
 		}
 
+		COUNT_OPS(T, OP_ADD, m_size);
+
 		return *this;
 	}
 
@@ -309,6 +333,8 @@ public:
 			m_data[i] -= other[i%other_size];	// TODO: WARN THAT B IS REPEATED
 		}
 
+		COUNT_OPS(T, OP_ADD, m_size);
+
 		return *this;
 	}
 
@@ -321,6 +347,8 @@ public:
 			m_data[i] -= aux;
 		}
 
+		COUNT_OPS(T, OP_ADD, m_size);
+
 		return *this;
 	}
 
@@ -333,6 +361,8 @@ public:
 			m_data[i] *= other[i%other_size];	// TODO: WARN THAT B IS REPEATED
 		}
 
+		COUNT_OPS(T, OP_MUL, m_size);
+
 		return *this;
 	}
 
@@ -345,6 +375,8 @@ public:
 			m_data[i] *= aux;
 		}
 
+		COUNT_OPS(T, OP_MUL, m_size);
+
 		return *this;
 	}
 	
@@ -357,6 +389,8 @@ public:
 			m_data[i] /= other[i%other_size];	// TODO: WARN THAT B IS REPEATED
 		}
 
+		COUNT_OPS(T, OP_DIV, m_size);
+
 		return *this;
 	}	
 
@@ -369,6 +403,8 @@ public:
 			m_data[i] /= aux;
 		}
 
+		COUNT_OPS(T, OP_DIV, m_size);
+
 		return *this;
 	}
 
@@ -434,7 +470,7 @@ public:
 				index = 0;
 				max = m_data[i+j];
 				for(size_t k=i+j+stride, l=1; l<axis_size; k+=stride, l++){	// loop elements to sum
-					if(m_data[k] > max) {
+					if(ordinal_less(max, m_data[k])) {
 						index = l;
 						max = m_data[k];
 					}
@@ -467,7 +503,7 @@ public:
 
 		size_t i;
 		auto comp = [this, &i](const argT& left, const argT& right) {
-            return (m_data[i+left] > m_data[i+right]);
+            return ordinal_less(m_data[i+right], m_data[i+left]);
         };
 
 		for(i=0; i<m_size; i+=nelem) {
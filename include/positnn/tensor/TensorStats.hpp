@@ -0,0 +1,201 @@
+#ifndef TENSORSTATS_HPP
+#define TENSORSTATS_HPP
+
+// General headers
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "StdTensor.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Elements sampled by default (0 = all)
+#ifndef TENSOR_STATS_SAMPLES
+	#define TENSOR_STATS_SAMPLES 4096
+#endif /* TENSOR_STATS_SAMPLES */
+
+// Statistics of the range of a posit tensor, estimated from a sample
+struct TensorStats {
+	size_t size = 0;		// # of elements of the tensor
+	size_t samples = 0;		// # of elements sampled
+	size_t zeros = 0;		// underflows (and exact zeros)
+	size_t saturated = 0;	// +-maxpos
+	size_t nar = 0;
+	int min_scale = 0;		// scale of the first bin of histogram
+	std::vector<size_t> histogram;	// # of samples with each log2 magnitude (scale)
+	double sum = 0;
+	double sum_sq = 0;
+
+	// Samples that are real numbers and have a scale
+	size_t nonzeros() const {
+		return samples - zeros - nar;
+	}
+
+	double mean() const {
+		size_t const n = samples - nar;
+		return (n>0) ? sum/n : 0;
+	}
+
+	double var() const {
+		size_t const n = samples - nar;
+		if(n == 0)
+			return 0;
+
+		double const m = sum/n;
+		double const v = sum_sq/n - m*m;
+		return (v>0) ? v : 0;
+	}
+
+	double std() const {
+		return std::sqrt(var());
+	}
+
+	double zero_ratio() const {
+		return (samples>0) ? double(zeros)/samples : 0;
+	}
+
+	double saturated_ratio() const {
+		return (samples>0) ? double(saturated)/samples : 0;
+	}
+
+	// Smallest scale such that a fraction p of the nonzero samples is below or at it
+	int percentile_scale(double const p) const {
+		size_t const target = static_cast<size_t>(std::ceil(p*nonzeros()));
+		size_t count = 0;
+
+		for(size_t i=0; i<histogram.size(); i++) {
+			count += histogram[i];
+			if(count >= target && count > 0)
+				return min_scale + static_cast<int>(i);
+		}
+
+		return min_scale + static_cast<int>(histogram.size()) - 1;
+	}
+
+	// Accumulate stats of another sample of a tensor with the same type
+	TensorStats& operator+=(TensorStats const& other) {
+		if(histogram.empty()) {
+			min_scale = other.min_scale;
+			histogram.assign(other.histogram.size(), 0);
+		}
+
+		size += other.size;
+		samples += other.samples;
+		zeros += other.zeros;
+		saturated += other.saturated;
+		nar += other.nar;
+		sum += other.sum;
+		sum_sq += other.sum_sq;
+
+		for(size_t i=0; i<histogram.size() && i<other.histogram.size(); i++)
+			histogram[i] += other.histogram[i];
+
+		return *this;
+	}
+};
+
+// Statistics of (at most) max_samples elements of x taken with a constant stride
+// Cost doesn't depend on the size of x, so it can be called every step
+template <size_t nbits, size_t es>
+TensorStats tensor_stats(StdTensor<posit<nbits, es>> const& x, size_t const max_samples=TENSOR_STATS_SAMPLES) {
+	int const max_scale = static_cast<int>((nbits-2) << es);
+	uint64_t const mask = (nbits<64) ? (uint64_t(1)<<nbits) - 1 : ~uint64_t(0);
+	uint64_t const maxpos_bits = mask >> 1;
+
+	TensorStats stats;
+	stats.size = x.size();
+	stats.min_scale = -max_scale;
+	stats.histogram.assign(2*max_scale + 1, 0);
+
+	if(x.size() == 0)
+		return stats;
+
+	// Odd stride, so that it doesn't follow power of 2 dimensions (e.g. channels)
+	size_t stride = 1;
+	if(max_samples>0 && x.size()>max_samples) {
+		stride = (x.size() + max_samples - 1) / max_samples;
+		stride |= 1;
+	}
+
+	for(size_t i=0, size=x.size(); i<size; i+=stride) {
+		posit<nbits, es> const& p = x[i];
+		stats.samples++;
+
+		if(p.iszero()) {
+			stats.zeros++;
+			continue;
+		}
+
+		if(p.isnar()) {
+			stats.nar++;
+			continue;
+		}
+
+		uint64_t bits = p.get().to_ullong();
+		if(p.isneg())
+			bits = (~bits + 1) & mask;
+
+		if(bits == maxpos_bits)
+			stats.saturated++;
+
+		stats.histogram[scale(p) + max_scale]++;
+
+		double const value = double(p);
+		stats.sum += value;
+		stats.sum_sq += value*value;
+	}
+
+	return stats;
+}
+
+// Print a table with the stats of each layer
+inline void print_tensor_stats(std::vector<TensorStats> const& stats, std::ostream& out=std::cout) {
+	char line[160];
+	std::snprintf(line, sizeof(line), "%6s %10s %10s %10s %10s %6s %12s %12s %8s %8s %8s",
+					"Layer", "Size", "Samples", "Zero [%]", "Sat. [%]", "NaR", "Mean", "Std",
+					"Scale 1%", "50%", "99%");
+	out << line << std::endl;
+
+	for(size_t i=0; i<stats.size(); i++) {
+		TensorStats const& s = stats[i];
+		std::snprintf(line, sizeof(line), "%6zu %10zu %10zu %10.3f %10.3f %6zu %12.4g %12.4g %8d %8d %8d",
+						i, s.size, s.samples, 100*s.zero_ratio(), 100*s.saturated_ratio(), s.nar,
+						s.mean(), s.std(), s.percentile_scale(0.01), s.percentile_scale(0.5),
+						s.percentile_scale(0.99));
+		out << line << std::endl;
+	}
+}
+
+// Append stats of each layer to a CSV file (one line per layer with its histogram)
+// Useful to plot how the range of each layer evolves (e.g. per epoch)
+inline int write_tensor_stats(std::string const& filename, std::vector<TensorStats> const& stats, size_t const step) {
+	std::ofstream file(filename, std::ios::app);
+
+	if(!file) {
+		std::cout << "Error in opening file: " << filename << std::endl;
+		return -1;
+	}
+
+	for(size_t i=0; i<stats.size(); i++) {
+		TensorStats const& s = stats[i];
+		file << step << "," << i << "," << s.size << "," << s.samples << ","
+			 << s.zeros << "," << s.saturated << "," << s.nar << ","
+			 << s.mean() << "," << s.std() << "," << s.min_scale;
+
+		for(size_t const count : s.histogram)
+			file << "," << count;
+
+		file << std::endl;
+	}
+
+	return 0;
+}
+
+#endif /* TENSORSTATS_HPP */
@@ -2,6 +2,11 @@
 #define WINDOW_HPP
 
 // General headers
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <tuple>
 #include <vector>
 
 // Custom headers
@@ -22,6 +27,52 @@ struct Window{
 	// Indices of above vectors where window starts for entry of output
 	std::vector<size_t> window_idx;
 
+	// Implicit windows: indices are computed from the geometry instead of stored in the vectors above
+	bool implicit = false;
+	size_t input_height, input_width;
+	size_t kernel_height, kernel_width;
+	size_t stride, padding, dilation;
+
+	// Outputs whose windows are inside the input, i.e. without padding (rows and cols [begin, end))
+	size_t interior_row_begin, interior_row_end;
+	size_t interior_col_begin, interior_col_end;
+
+	// Used for convolutions without dilation of the input
+	// Only the geometry is kept, so there are no index vectors to build and to read
+	void implicit_output_to_input(	size_t const input_height0, size_t const input_width0,
+									size_t const kernel_height0, size_t const kernel_width0,
+									size_t const stride0=1, size_t const padding0=0, size_t const dilation0=1	){
+
+		input_height = input_height0;
+		input_width = input_width0;
+		kernel_height = kernel_height0;
+		kernel_width = kernel_width0;
+		stride = stride0;
+		padding = padding0;
+		dilation = dilation0;
+
+		// Calculate output dimensions
+		output_height = (input_height + 2*padding - (kernel_height-1)*dilation - 1)/stride + 1;
+		output_width = (input_width + 2*padding - (kernel_width-1)*dilation - 1)/stride + 1;
+
+		interior(input_height, kernel_height, output_height, interior_row_begin, interior_row_end);
+		interior(input_width, kernel_width, output_width, interior_col_begin, interior_col_end);
+
+		// Clear window vectors
+		map_window.clear();
+		kernel_window.clear();
+		window_idx.clear();
+		map_window.shrink_to_fit();
+		kernel_window.shrink_to_fit();
+		window_idx.shrink_to_fit();
+
+		// Windows are initialized
+		implicit = true;
+		initialized = true;
+
+		return;
+	}
+
 	// Used when you know the start and want to go forward
 	void output_to_input(	size_t const input_height0, size_t const input_width0,
 							size_t const kernel_height0, size_t const kernel_width0,
@@ -102,6 +153,7 @@ struct Window{
 		window_idx.shrink_to_fit();
 
 		// Windows are initialized
+		implicit = false;
 		initialized = true;
 
 		return;
@@ -188,10 +240,106 @@ struct Window{
 		window_idx.push_back(size);
 		
 		// Windows are initialized
+		implicit = false;
 		initialized = true;
 
 		return;
 	}
+
+private:
+	// Outputs [begin, end) along one dimension whose windows don't overlap the padding
+	void interior(	size_t const input_size, size_t const kernel_size, size_t const output_size,
+					size_t& begin, size_t& end	) const {
+
+		size_t const kernel_extent = (kernel_size-1)*dilation;
+
+		begin = (padding + stride - 1) / stride;
+		end = (input_size + padding >= kernel_extent + 1) ? (input_size + padding - kernel_extent - 1)/stride + 1 : 0;
+
+		if(end > output_size)
+			end = output_size;
+		if(begin > end)
+			begin = end;
+	}
 };
 
+// How a window is built
+enum class WindowMap {output_to_input, implicit_output_to_input, input_to_output};
+
+// Geometry of a window, i.e. the arguments to build it
+struct WindowGeometry{
+	WindowMap map;
+	size_t input_height, input_width;
+	size_t kernel_height, kernel_width;
+	size_t stride, padding;
+	size_t dilation_input, dilation_kernel;
+
+	bool operator<(WindowGeometry const& other) const {
+		return	std::tie(map, input_height, input_width, kernel_height, kernel_width, stride, padding, dilation_input, dilation_kernel) <
+				std::tie(other.map, other.input_height, other.input_width, other.kernel_height, other.kernel_width,
+						other.stride, other.padding, other.dilation_input, other.dilation_kernel);
+	}
+};
+
+// Window with that geometry, shared by all layers, models and threads
+// Each window is built once per process, when it is first used, and isn't changed or freed after that
+// (layers keep pointers to them), so there is one per geometry used, i.e. per layer and input size,
+// and models with inputs of many sizes (e.g. before an AdaptiveAvgPool2d) keep one for each of them
+// Lookups of windows already built only take a shared lock, so threads don't wait for each other
+inline Window const& shared_window(WindowGeometry const& g) {
+	static std::shared_timed_mutex mutex;	// C++14 (std::shared_mutex is C++17)
+	static std::map<WindowGeometry, std::unique_ptr<Window>> windows;
+
+	{
+		std::shared_lock<std::shared_timed_mutex> lock(mutex);
+		auto const it = windows.find(g);
+
+		if(it != windows.end())
+			return *it->second;
+	}
+
+	std::lock_guard<std::shared_timed_mutex> lock(mutex);
+	std::unique_ptr<Window>& w = windows[g];
+
+	// Unless another thread built it since the lookup
+	if(!w) {
+		w.reset(new Window());
+
+		switch(g.map) {
+			case WindowMap::output_to_input:
+				w->output_to_input(	g.input_height, g.input_width, g.kernel_height, g.kernel_width,
+									g.stride, g.padding, g.dilation_input, g.dilation_kernel	);
+				break;
+			case WindowMap::implicit_output_to_input:
+				w->implicit_output_to_input(	g.input_height, g.input_width, g.kernel_height, g.kernel_width,
+												g.stride, g.padding, g.dilation_kernel	);
+				break;
+			case WindowMap::input_to_output:
+				w->input_to_output(	g.input_height, g.input_width, g.kernel_height, g.kernel_width,
+									g.stride, g.padding	);
+				break;
+		}
+	}
+
+	return *w;
+}
+
+// Window of a convolution of an input with a weight (indices are only stored if the input is dilated)
+inline Window const& convolution2d_window(	std::vector<size_t> const& input_shape, std::vector<size_t> const& weight_shape,
+											size_t const stride=1, size_t const padding=0,
+											size_t const dilation_input=1, size_t const dilation_kernel=1	){
+
+	WindowMap const map = (dilation_input==1) ? WindowMap::implicit_output_to_input : WindowMap::output_to_input;
+	return shared_window({	map, input_shape[2], input_shape[3], weight_shape[2], weight_shape[3],
+							stride, padding, dilation_input, dilation_kernel	});
+}
+
+// Window of a pooling of an input
+inline Window const& pool2d_window(	std::vector<size_t> const& input_shape, size_t const kernel_size,
+									size_t const stride, size_t const padding	){
+
+	return shared_window({	WindowMap::output_to_input, input_shape[2], input_shape[3], kernel_size, kernel_size,
+							stride, padding, 1, 1	});
+}
+
 #endif /* WINDOW_HPP */
@@ -8,6 +8,7 @@
 #endif /* LL_THREADS */
 
 // General headers
+#include <functional>
 #ifdef USING_LL_THREADS
 #include <thread>
 #endif /* USING_LL_THREADS */
@@ -17,6 +18,7 @@
 // Custom headers
 #include "StdTensor.hpp"
 #include "Window.hpp"
+#include "../utils/parallel.hpp"
 #include "../utils/Quire.hpp"
 
 // Namespaces
@@ -113,22 +115,14 @@ StdTensor<posit<nbits, es>> averagepool2d(	StdTensor<posit<nbits, es>> const& in
 											size_t const kernel_size,
 											size_t const stride,
 											size_t const padding,
-											Window* w=NULL	){
+											Window const* w=NULL	){
 	//
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 	
-	// Get windows
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							kernel_size, kernel_size,
-							stride, padding	);
-	}
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(input.shape(), kernel_size, stride, padding);
 
 	// Get batch size and # of input channels
 	size_t const batch_size = input.shape()[0];
@@ -187,9 +181,6 @@ StdTensor<posit<nbits, es>> averagepool2d(	StdTensor<posit<nbits, es>> const& in
 		t.join();
 	}	
 
-	if(empty)
-		delete w;
-
 	return output;
 }
 
@@ -201,21 +192,14 @@ StdTensor<posit<nbits, es>> averagepool2d(	StdTensor<posit<nbits, es>> const& in
 											size_t const kernel_size,
 											size_t const stride,
 											size_t const padding,
-											Window* w=NULL	){
+											Window const* w=NULL	){
 
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							kernel_size, kernel_size,
-							stride, padding	);
-	}
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(input.shape(), kernel_size, stride, padding);
 
 	size_t const batch_size = input.shape()[0];
 	size_t const input_channels = input.shape()[1];
@@ -258,9 +242,6 @@ StdTensor<posit<nbits, es>> averagepool2d(	StdTensor<posit<nbits, es>> const& in
 		output_batch += output_batch_stride;
 	}
 
-	if(empty)
-		delete w;
-
 	return output;
 }
 
@@ -272,20 +253,14 @@ StdTensor<posit<nbits, es>> averagepool2d_backward(	StdTensor<posit<nbits, es>>
 													size_t const kernel_size,
 													size_t const stride,
 													size_t const padding,
-													Window* w=NULL	){
+													Window const* w=NULL	){
 
 	// Throw error if stride!=kernel_size
 	
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->input_to_output(	input_shape[2], input_shape[3],
-							kernel_size, kernel_size,
-							stride, padding	);
-	}
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &shared_window({	WindowMap::input_to_output, input_shape[2], input_shape[3],
+								kernel_size, kernel_size, stride, padding, 1, 1	});
 
 	size_t const kernel_total_size = kernel_size*kernel_size;
 
@@ -317,8 +292,127 @@ StdTensor<posit<nbits, es>> averagepool2d_backward(	StdTensor<posit<nbits, es>>
 		output_channel += output_channel_stride;
 	}
 
-	if(empty)
-		delete w;
+	return deltaN_1;
+}
+
+// Rows (or cols) [begin, end) of the input of bin i of adaptive pooling, like PyTorch:
+// begin = floor(i*input_size/output_size) and end = ceil((i+1)*input_size/output_size)
+// Bins cover the whole input and only overlap if input_size isn't a multiple of output_size
+inline void adaptive_pool_bin(	size_t const i, size_t const input_size, size_t const output_size,
+								size_t& begin, size_t& end	){
+	begin = (i * input_size) / output_size;
+	end = ((i+1) * input_size + output_size - 1) / output_size;
+}
+
+// Adaptive average pooling of some units (channels of a sample, numbered through batch and channels)
+// Each channel is reduced with a quire per bin, reading its rows contiguously, without windows
+// With output {1, 1} (global average pooling), that is a single contiguous reduction over height*width
+template <size_t nbits, size_t es>
+void adaptive_averagepool2d_thread(	StdTensor<posit<nbits, es>> const& input,
+									StdTensor<posit<nbits, es>>& output,
+									size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_height = input.shape()[2];
+	size_t const input_width = input.shape()[3];
+	size_t const output_height = output.shape()[2];
+	size_t const output_width = output.shape()[3];
+	size_t const input_size = input_height * input_width;
+	size_t const output_size = output_height * output_width;
+
+	// Initialize Quire
+	Quire<nbits, es> q;
+	size_t row_begin, row_end, col_begin, col_end;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const input_channel = unit * input_size;
+		size_t output_idx = unit * output_size;
+
+		// Loop through output rows and cols
+		for(size_t i=0; i<output_height; i++){
+			adaptive_pool_bin(i, input_height, output_height, row_begin, row_end);
+
+			for(size_t j=0; j<output_width; j++, output_idx++){
+				adaptive_pool_bin(j, input_width, output_width, col_begin, col_end);
+
+				q.clear();
+				for(size_t row=row_begin; row<row_end; row++){
+					for(size_t k=input_channel+row*input_width+col_begin, k_end=k+col_end-col_begin; k<k_end; k++)
+						q += input[k];
+				}
+
+				convert(q.to_value(), output[output_idx]);
+				output[output_idx] /= (row_end-row_begin) * (col_end-col_begin);
+			}
+		}
+	}
+}
+
+// Backward of the adaptive average pooling of some units (see adaptive_averagepool2d_thread)
+// The delta of each output is divided by the size of its bin and broadcast to the inputs of the bin
+template <size_t nbits, size_t es>
+void adaptive_averagepool2d_backward_thread(	StdTensor<posit<nbits, es>> const& delta,
+												StdTensor<posit<nbits, es>>& deltaN_1,
+												size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_height = deltaN_1.shape()[2];
+	size_t const input_width = deltaN_1.shape()[3];
+	size_t const output_height = delta.shape()[2];
+	size_t const output_width = delta.shape()[3];
+	size_t const input_size = input_height * input_width;
+	size_t const output_size = output_height * output_width;
+
+	size_t row_begin, row_end, col_begin, col_end;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const input_channel = unit * input_size;
+		size_t output_idx = unit * output_size;
+
+		// Loop through output rows and cols
+		for(size_t i=0; i<output_height; i++){
+			adaptive_pool_bin(i, input_height, output_height, row_begin, row_end);
+
+			for(size_t j=0; j<output_width; j++, output_idx++){
+				adaptive_pool_bin(j, input_width, output_width, col_begin, col_end);
+
+				posit<nbits, es> const value = delta[output_idx] / ((row_end-row_begin) * (col_end-col_begin));
+
+				// Bins only overlap if the input size isn't a multiple of the output size
+				for(size_t row=row_begin; row<row_end; row++){
+					for(size_t k=input_channel+row*input_width+col_begin, k_end=k+col_end-col_begin; k<k_end; k++)
+						deltaN_1[k] += value;
+				}
+			}
+		}
+	}
+}
+
+// Average pooling of an input {batch, channels, height, width} to an output {batch, channels, output_height, output_width},
+// with bins of the input of (almost) the same size (see adaptive_pool_bin)
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> adaptive_averagepool2d(	StdTensor<posit<nbits, es>> const& input,
+													size_t const output_height, size_t const output_width	){
+
+	size_t const batch_size = input.shape()[0];
+	size_t const channels = input.shape()[1];
+
+	StdTensor<posit<nbits, es>> output({batch_size, channels, output_height, output_width});
+
+	parallel_units(	batch_size*channels, adaptive_averagepool2d_thread<nbits, es>,
+					std::cref(input), std::ref(output)	);
+
+	return output;
+}
+
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> adaptive_averagepool2d_backward(	StdTensor<posit<nbits, es>> const& delta,
+																std::vector<size_t> const& input_shape	){
+
+	StdTensor<posit<nbits, es>> deltaN_1(input_shape);
+
+	parallel_units(	input_shape[0]*input_shape[1], adaptive_averagepool2d_backward_thread<nbits, es>,
+					std::cref(delta), std::ref(deltaN_1)	);
 
 	return deltaN_1;
 }
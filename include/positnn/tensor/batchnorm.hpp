@@ -0,0 +1,165 @@
+#ifndef BATCHNORM_HPP
+#define BATCHNORM_HPP
+
+// General headers
+#include <functional>
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "StdTensor.hpp"
+#include "../utils/parallel.hpp"
+#include "../utils/Quire.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Kernels of batch norms for a tensor seen as {outer, channels, inner} (see channel_sums)
+// Work is divided in units (inner blocks of a channel, numbered through outer and channels)
+
+// Normalization of some units: x_norm = (x - mean) * inv_stddev and y = x_norm * gamma + beta
+// gamma and beta are empty without affine, and x_norm is only stored if not NULL
+template <size_t nbits, size_t es>
+void batchnorm_forward_thread(	StdTensor<posit<nbits, es>> const& x,
+								StdTensor<posit<nbits, es>> const& mean,
+								StdTensor<posit<nbits, es>> const& inv_stddev,
+								StdTensor<posit<nbits, es>> const& gamma,
+								StdTensor<posit<nbits, es>> const& beta,
+								StdTensor<posit<nbits, es>>& y,
+								StdTensor<posit<nbits, es>>* x_norm,
+								size_t const inner,
+								size_t const unit_begin, size_t const unit_end	){
+
+	bool const affine = !gamma.empty();
+	size_t const channels = mean.size();
+
+	Quire<nbits, es> q;
+
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const c = unit % channels;
+
+		for(size_t i=unit*inner, i_end=i+inner; i<i_end; i++){
+			posit<nbits, es> const normalized = (x[i] - mean[c]) * inv_stddev[c];
+
+			if(x_norm != NULL)
+				(*x_norm)[i] = normalized;
+
+			if(affine){
+				q = beta[c];
+				q += Quire_mul(normalized, gamma[c]);
+				convert(q.to_value(), y[i]);
+			}
+			else {
+				y[i] = normalized;
+			}
+		}
+	}
+}
+
+// y = x * scale + shift of some units (e.g. batch norm with running statistics)
+template <size_t nbits, size_t es>
+void batchnorm_scale_shift_thread(	StdTensor<posit<nbits, es>> const& x,
+									StdTensor<posit<nbits, es>> const& scale,
+									StdTensor<posit<nbits, es>> const& shift,
+									StdTensor<posit<nbits, es>>& y,
+									size_t const inner,
+									size_t const unit_begin, size_t const unit_end	){
+
+	size_t const channels = scale.size();
+
+	Quire<nbits, es> q;
+
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const c = unit % channels;
+
+		for(size_t i=unit*inner, i_end=i+inner; i<i_end; i++){
+			q = shift[c];
+			q += Quire_mul(x[i], scale[c]);
+			convert(q.to_value(), y[i]);
+		}
+	}
+}
+
+// Gradient of the input of some units: delta_1 = scale * (delta - mean_delta - x_norm * mean_delta_x_norm)
+// with scale = gamma * inv_stddev (or inv_stddev without affine)
+template <size_t nbits, size_t es>
+void batchnorm_backward_thread(	StdTensor<posit<nbits, es>> const& delta,
+								StdTensor<posit<nbits, es>> const& x_norm,
+								StdTensor<posit<nbits, es>> const& mean_delta,
+								StdTensor<posit<nbits, es>> const& mean_delta_x_norm,
+								StdTensor<posit<nbits, es>> const& scale,
+								StdTensor<posit<nbits, es>>& delta_1,
+								size_t const inner,
+								size_t const unit_begin, size_t const unit_end	){
+
+	size_t const channels = scale.size();
+
+	Quire<nbits, es> q;
+	posit<nbits, es> centered;
+
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const c = unit % channels;
+
+		for(size_t i=unit*inner, i_end=i+inner; i<i_end; i++){
+			q = delta[i];
+			q -= mean_delta[c];
+			q -= Quire_mul(x_norm[i], mean_delta_x_norm[c]);
+			convert(q.to_value(), centered);
+
+			delta_1[i] = centered * scale[c];
+		}
+	}
+}
+
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> batchnorm_forward(	StdTensor<posit<nbits, es>> const& x,
+												StdTensor<posit<nbits, es>> const& mean,
+												StdTensor<posit<nbits, es>> const& inv_stddev,
+												StdTensor<posit<nbits, es>> const& gamma,
+												StdTensor<posit<nbits, es>> const& beta,
+												size_t const inner,
+												StdTensor<posit<nbits, es>>* x_norm=NULL	){
+
+	StdTensor<posit<nbits, es>> y(x.shape());
+	if(x_norm != NULL)
+		x_norm->reshape(x.shape());
+
+	parallel_units(	x.size() / ((inner>0) ? inner : 1), batchnorm_forward_thread<nbits, es>,
+					std::cref(x), std::cref(mean), std::cref(inv_stddev), std::cref(gamma), std::cref(beta),
+					std::ref(y), x_norm, inner	);
+
+	return y;
+}
+
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> batchnorm_scale_shift(	StdTensor<posit<nbits, es>> const& x,
+													StdTensor<posit<nbits, es>> const& scale,
+													StdTensor<posit<nbits, es>> const& shift,
+													size_t const inner	){
+
+	StdTensor<posit<nbits, es>> y(x.shape());
+
+	parallel_units(	x.size() / ((inner>0) ? inner : 1), batchnorm_scale_shift_thread<nbits, es>,
+					std::cref(x), std::cref(scale), std::cref(shift), std::ref(y), inner	);
+
+	return y;
+}
+
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> batchnorm_backward(	StdTensor<posit<nbits, es>> const& delta,
+												StdTensor<posit<nbits, es>> const& x_norm,
+												StdTensor<posit<nbits, es>> const& mean_delta,
+												StdTensor<posit<nbits, es>> const& mean_delta_x_norm,
+												StdTensor<posit<nbits, es>> const& scale,
+												size_t const inner	){
+
+	StdTensor<posit<nbits, es>> delta_1(delta.shape());
+
+	parallel_units(	delta.size() / ((inner>0) ? inner : 1), batchnorm_backward_thread<nbits, es>,
+					std::cref(delta), std::cref(x_norm), std::cref(mean_delta), std::cref(mean_delta_x_norm),
+					std::cref(scale), std::ref(delta_1), inner	);
+
+	return delta_1;
+}
+
+#endif /* BATCHNORM_HPP */
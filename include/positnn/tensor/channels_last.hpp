@@ -0,0 +1,975 @@
+#ifndef CHANNELS_LAST_HPP
+#define CHANNELS_LAST_HPP
+
+#ifdef LL_THREADS
+	#if LL_THREADS>1
+		#define USING_LL_THREADS
+	#endif
+#endif /* LL_THREADS */
+
+// General headers
+#include <cstdint>
+#ifdef USING_LL_THREADS
+#include <thread>
+#endif /* USING_LL_THREADS */
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "averagepool.hpp"
+#include "convolution.hpp"
+#include "convolution_maximumpool.hpp"
+#include "maximumpool.hpp"
+#include "StdTensor.hpp"
+#include "Window.hpp"
+#include "../utils/Quire.hpp"
+#include "../utils/utils.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Memory layout of the activations of convolutional layers
+// channels_first: {batch, channels, height, width} (NCHW), the default
+// channels_last: {batch, height, width, channels} (NHWC), so the channels of a pixel are contiguous
+// and convolutions reduce over the input channels with unit stride
+// Parameters have the same layout in both, so models can be saved and loaded with either
+enum class Layout {channels_first, channels_last};
+
+// Shape {N, H, W, C} of a tensor with shape {N, C, H, W} and vice versa
+inline std::vector<size_t> channels_last_shape(std::vector<size_t> const& shape) {
+	return {shape[0], shape[2], shape[3], shape[1]};
+}
+
+inline std::vector<size_t> channels_first_shape(std::vector<size_t> const& shape) {
+	return {shape[0], shape[3], shape[1], shape[2]};
+}
+
+// Shape of the output of a convolution or pooling of an input with shape (and layout), without computing it
+// (output_channels=0 keeps the channels of the input, as in pooling)
+inline std::vector<size_t> window2d_output_shape(	std::vector<size_t> const& shape, Layout const layout,
+													size_t const output_channels, size_t const kernel_size,
+													size_t const stride=1, size_t const padding=0, size_t const dilation=1	){
+
+	std::vector<size_t> output = (layout == Layout::channels_last) ? channels_first_shape(shape) : shape;
+	if(output_channels > 0)
+		output[1] = output_channels;
+
+	for(size_t i=2; i<4; i++)
+		output[i] = (output[i] + 2*padding - (kernel_size-1)*dilation - 1)/stride + 1;
+
+	return (layout == Layout::channels_last) ? channels_last_shape(output) : output;
+}
+
+// Convert a tensor from {N, C, H, W} to {N, H, W, C} (e.g. at the input of a model)
+// Tensors with other dimensions are returned as they are
+template <typename T>
+StdTensor<T> to_channels_last(StdTensor<T> const& x) {
+	if(x.dim() != 4)
+		return x;
+
+	size_t const batch_size = x.shape()[0];
+	size_t const channels = x.shape()[1];
+	size_t const size = x.strides()[1];
+
+	StdTensor<T> y(channels_last_shape(x.shape()));
+
+	for(size_t n=0, i=0; n<batch_size; n++)
+		for(size_t c=0; c<channels; c++)
+			for(size_t idx=0; idx<size; idx++, i++)
+				y[(n*size + idx)*channels + c] = x[i];
+
+	return y;
+}
+
+// Convert a tensor from {N, H, W, C} to {N, C, H, W}
+template <typename T>
+StdTensor<T> to_channels_first(StdTensor<T> const& x) {
+	if(x.dim() != 4)
+		return x;
+
+	size_t const batch_size = x.shape()[0];
+	size_t const channels = x.shape()[3];
+	size_t const size = x.shape()[1] * x.shape()[2];
+
+	StdTensor<T> y(channels_first_shape(x.shape()));
+
+	for(size_t n=0, i=0; n<batch_size; n++)
+		for(size_t c=0; c<channels; c++)
+			for(size_t idx=0; idx<size; idx++, i++)
+				y[i] = x[(n*size + idx)*channels + c];
+
+	return y;
+}
+
+// Convolution of channels last input for some units (output rows of a sample, numbered through samples and rows)
+// Weight is permuted to {out_channels, kernel_height, kernel_width, in_channels/groups}, so both the
+// input and the weight are contiguous in the reduction over input channels
+template <size_t nbits, size_t es>
+void convolution2d_channels_last_thread(	StdTensor<posit<nbits, es>> const& input,
+											StdTensor<posit<nbits, es>> const& weight,
+											StdTensor<posit<nbits, es>> const& bias,
+											StdTensor<posit<nbits, es>>& output,
+											size_t const stride, size_t const padding, size_t const dilation, size_t const groups,
+											size_t const unit_begin, size_t const unit_end	){
+
+	// Check if bias is empty
+	bool const no_bias = bias.empty();
+
+	// Sizes of input, output and weight
+	size_t const height = input.shape()[1];
+	size_t const width = input.shape()[2];
+	size_t const input_channels = input.shape()[3];
+	size_t const output_height = output.shape()[1];
+	size_t const output_width = output.shape()[2];
+	size_t const output_channels = output.shape()[3];
+	size_t const kernel_height = weight.shape()[1];
+	size_t const kernel_width = weight.shape()[2];
+	size_t const group_input_channels = weight.shape()[3];
+
+	// Output channels of each group
+	size_t const group_channels = output_channels / groups;
+
+	// Initialize Quire
+	Quire<nbits, es> q;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const y = unit % output_height;
+		size_t const sample = (unit / output_height) * height;
+		size_t n = unit * output_width * output_channels;
+
+		// Loop through cols of output row
+		for(size_t x=0; x<output_width; x++){
+
+			// Loop through output channels
+			for(size_t o=0; o<output_channels; o++){
+				size_t const input_group = (o / group_channels) * group_input_channels;
+				size_t const weight_channel = o * kernel_height;
+
+				// Set Quire to bias value
+				if(no_bias)
+					q.clear();
+				else
+					q = bias[o];
+
+				// Loop through kernel rows and cols inside the input
+				for(size_t kh=0; kh<kernel_height; kh++){
+					if(y*stride + kh*dilation < padding)
+						continue;
+
+					size_t const input_y = y*stride + kh*dilation - padding;
+					if(input_y >= height)
+						break;
+
+					for(size_t kw=0; kw<kernel_width; kw++){
+						if(x*stride + kw*dilation < padding)
+							continue;
+
+						size_t const input_x = x*stride + kw*dilation - padding;
+						if(input_x >= width)
+							break;
+
+						size_t const input_idx = ((sample + input_y)*width + input_x)*input_channels + input_group;
+						size_t const weight_idx = ((weight_channel + kh)*kernel_width + kw)*group_input_channels;
+
+						// Loop through input channels of the group
+						for(size_t c=0; c<group_input_channels; c++)
+							q += Quire_mul(input[input_idx+c], weight[weight_idx+c]);
+					}
+				}
+
+				// Convert result from Quire to posit
+				convert(q.to_value(), output[n++]);
+			}
+		}
+	}
+}
+
+// Same as convolution2d for an input {batch, height, width, in_channels}, with output {batch, height, width, out_channels}
+// Weight is {out_channels, in_channels/groups, kernel_height, kernel_width}, like with channels first
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> convolution2d_channels_last(	StdTensor<posit<nbits, es>> const& input,
+															StdTensor<posit<nbits, es>> const& weight,
+															StdTensor<posit<nbits, es>> const& bias,
+															size_t const stride=1,
+															size_t const padding=0,
+															size_t const dilation=1,
+															size_t const groups=1	){
+
+	// Get batch size and # of output channels
+	size_t const batch_size = input.shape()[0];
+	size_t const output_channels = weight.shape()[0];
+
+	convolution2d_groups(input.shape()[3], weight.shape()[1], output_channels, groups);
+
+	// Output size is the same as with channels first
+	Window const& w = convolution2d_window(channels_first_shape(input.shape()), weight.shape(), stride, padding, 1, dilation);
+
+	StdTensor<posit<nbits, es>> const permuted_weight = to_channels_last(weight);
+
+	// Create tensor for output
+	StdTensor<posit<nbits, es>> output({batch_size, w.output_height, w.output_width, output_channels});
+
+#ifndef USING_LL_THREADS
+	convolution2d_channels_last_thread<nbits, es>(	input, permuted_weight, bias, output, stride, padding, dilation, groups,
+													0, batch_size*w.output_height	);
+#else
+	// Distribute threads by samples and rows (see convolution2d_partition)
+	size_t const row_work = w.output_width * weight.size();
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, 1, w.output_height,
+																row_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(convolution2d_channels_last_thread<nbits, es>,
+										std::cref(input), std::cref(permuted_weight), std::cref(bias), std::ref(output),
+										stride, padding, dilation, groups,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return output;
+}
+
+// Gradient of the weights for some units (kernel rows of an output channel, numbered through output channels and rows)
+// Keeps a quire per kernel col and input channel, so the input is read contiguously
+template <size_t nbits, size_t es>
+void convolution2d_gradient_channels_last_thread(	StdTensor<posit<nbits, es>> const& input,
+													StdTensor<posit<nbits, es>> const& delta,
+													StdTensor<posit<nbits, es>>& dweight,
+													size_t const stride, size_t const padding, size_t const dilation, size_t const groups,
+													size_t const unit_begin, size_t const unit_end	){
+
+	// Sizes of input, delta and weight
+	size_t const batch_size = input.shape()[0];
+	size_t const height = input.shape()[1];
+	size_t const width = input.shape()[2];
+	size_t const input_channels = input.shape()[3];
+	size_t const delta_height = delta.shape()[1];
+	size_t const delta_width = delta.shape()[2];
+	size_t const output_channels = delta.shape()[3];
+	size_t const group_input_channels = dweight.shape()[1];
+	size_t const kernel_height = dweight.shape()[2];
+	size_t const kernel_width = dweight.shape()[3];
+
+	// Output channels of each group
+	size_t const group_channels = output_channels / groups;
+
+	// Initialize Quires
+	std::vector<Quire<nbits, es>> q(kernel_width * group_input_channels);
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const kh = unit % kernel_height;
+		size_t const o = unit / kernel_height;
+		size_t const input_group = (o / group_channels) * group_input_channels;
+
+		for(Quire<nbits, es>& qi : q)
+			qi.clear();
+
+		// Loop through batch and rows of delta inside the input
+		for(size_t batch=0; batch<batch_size; batch++){
+			for(size_t y=0; y<delta_height; y++){
+				if(y*stride + kh*dilation < padding)
+					continue;
+
+				size_t const input_y = y*stride + kh*dilation - padding;
+				if(input_y >= height)
+					break;
+
+				size_t const input_row = (batch*height + input_y)*width;
+				size_t delta_idx = ((batch*delta_height + y)*delta_width)*output_channels + o;
+
+				// Loop through cols of delta
+				for(size_t x=0; x<delta_width; x++, delta_idx+=output_channels){
+					posit<nbits, es> const d = delta[delta_idx];
+
+					for(size_t kw=0; kw<kernel_width; kw++){
+						if(x*stride + kw*dilation < padding)
+							continue;
+
+						size_t const input_x = x*stride + kw*dilation - padding;
+						if(input_x >= width)
+							break;
+
+						size_t const input_idx = (input_row + input_x)*input_channels + input_group;
+						Quire<nbits, es>* qk = &q[kw*group_input_channels];
+
+						// Loop through input channels of the group
+						for(size_t c=0; c<group_input_channels; c++)
+							qk[c] += Quire_mul(input[input_idx+c], d);
+					}
+				}
+			}
+		}
+
+		// Convert results from Quires to posits
+		for(size_t c=0; c<group_input_channels; c++){
+			for(size_t kw=0; kw<kernel_width; kw++){
+				convert(q[kw*group_input_channels + c].to_value(),
+						dweight[((o*group_input_channels + c)*kernel_height + kh)*kernel_width + kw]);
+			}
+		}
+	}
+}
+
+// Same as convolution2d_gradient for channels last input and delta
+// Gradient is {out_channels, in_channels/groups, kernel_height, kernel_width}, like with channels first
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> convolution2d_gradient_channels_last(	StdTensor<posit<nbits, es>> const& input,
+																	StdTensor<posit<nbits, es>> const& delta,
+																	size_t const stride=1,
+																	size_t const padding=0,
+																	size_t const dilation=1,
+																	size_t const groups=1	){
+
+	size_t const input_channels = (groups>0) ? input.shape()[3] / groups : 0;
+	size_t const output_channels = delta.shape()[3];
+	convolution2d_groups(input.shape()[3], input_channels, output_channels, groups);
+
+	// Size of the kernel is the same as with channels first
+	Window const& w = shared_window({	WindowMap::implicit_output_to_input, input.shape()[1], input.shape()[2],
+										delta.shape()[1], delta.shape()[2], dilation, padding, 1, stride	});
+
+	StdTensor<posit<nbits, es>> dweight({output_channels, input_channels, w.output_height, w.output_width});
+
+#ifndef USING_LL_THREADS
+	convolution2d_gradient_channels_last_thread<nbits, es>(	input, delta, dweight, stride, padding, dilation, groups,
+															0, output_channels*w.output_height	);
+#else
+	// Distribute threads by output channels and kernel rows (see convolution2d_partition)
+	size_t const row_work = delta.size() / output_channels * w.output_width * input_channels;
+	std::vector<size_t> const begin = convolution2d_partition(	1, output_channels, w.output_height,
+																row_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(convolution2d_gradient_channels_last_thread<nbits, es>,
+										std::cref(input), std::cref(delta), std::ref(dweight),
+										stride, padding, dilation, groups,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return dweight;
+}
+
+// Gradient of the input for some units (rows of a sample, numbered through samples and rows)
+// Weight is permuted to {kernel_height, kernel_width, in_channels/groups, out_channels}, so both
+// the delta and the weight are contiguous in the reduction over output channels
+template <size_t nbits, size_t es>
+void convolution2d_input_gradient_channels_last_thread(	StdTensor<posit<nbits, es>> const& delta,
+														StdTensor<posit<nbits, es>> const& weight,
+														StdTensor<posit<nbits, es>>& deltaN,
+														TransposedTaps const* rows, TransposedTaps const* cols,
+														size_t const unit_begin, size_t const unit_end	){
+
+	// Sizes of delta, deltaN and weight
+	size_t const delta_height = delta.shape()[1];
+	size_t const delta_width = delta.shape()[2];
+	size_t const output_channels = delta.shape()[3];
+	size_t const height = deltaN.shape()[1];
+	size_t const width = deltaN.shape()[2];
+	size_t const input_channels = deltaN.shape()[3];
+	size_t const kernel_width = weight.shape()[1];
+	size_t const group_input_channels = weight.shape()[2];
+
+	// Output channels of each group
+	size_t const group_channels = output_channels / (input_channels / group_input_channels);
+
+	// Initialize Quire
+	Quire<nbits, es> q;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const y = unit % height;
+		size_t const sample = (unit / height) * delta_height;
+		size_t n = unit * width * input_channels;
+
+		// Loop through cols
+		for(size_t x=0; x<width; x++){
+
+			// Loop through input channels
+			for(size_t c=0; c<input_channels; c++){
+				size_t const output_group = (c / group_input_channels) * group_channels;
+				size_t const weight_channel = (c % group_input_channels) * output_channels + output_group;
+
+				q.clear();
+
+				// Loop through taps of this row and col
+				for(size_t r=rows->begin[y]; r<rows->begin[y+1]; r++){
+					size_t const delta_row = (sample + rows->output[r])*delta_width;
+					size_t const weight_row = rows->kernel[r]*kernel_width;
+
+					for(size_t s=cols->begin[x]; s<cols->begin[x+1]; s++){
+						size_t const delta_idx = (delta_row + cols->output[s])*output_channels + output_group;
+						size_t const weight_idx = (weight_row + cols->kernel[s])*group_input_channels*output_channels + weight_channel;
+
+						// Loop through output channels of the group
+						for(size_t o=0; o<group_channels; o++)
+							q += Quire_mul(delta[delta_idx+o], weight[weight_idx+o]);
+					}
+				}
+
+				// Convert result from Quire to posit
+				convert(q.to_value(), deltaN[n++]);
+			}
+		}
+	}
+}
+
+// Same as convolution2d_input_gradient for channels last delta, with deltaN {batch, height, width, in_channels}
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> convolution2d_input_gradient_channels_last(	StdTensor<posit<nbits, es>> const& delta,
+																		StdTensor<posit<nbits, es>> const& weight,
+																		size_t const height, size_t const width,
+																		size_t const stride=1,
+																		size_t const padding=0,
+																		size_t const dilation=1,
+																		size_t const groups=1	){
+
+	// Get batch size and # of input channels
+	size_t const batch_size = delta.shape()[0];
+	size_t const output_channels = weight.shape()[0];
+	size_t const group_input_channels = weight.shape()[1];
+	size_t const input_channels = group_input_channels * groups;
+	convolution2d_groups(input_channels, group_input_channels, output_channels, groups);
+
+	// Taps of rows and cols
+	TransposedTaps rows, cols;
+	rows.init(height, delta.shape()[1], weight.shape()[2], stride, padding, dilation);
+	cols.init(width, delta.shape()[2], weight.shape()[3], stride, padding, dilation);
+
+	// Permute weight to {kernel_height, kernel_width, in_channels/groups, out_channels}
+	size_t const kernel_size = weight.strides()[1];
+	StdTensor<posit<nbits, es>> permuted_weight({weight.shape()[2], weight.shape()[3], group_input_channels, output_channels});
+
+	for(size_t o=0, i=0; o<output_channels; o++)
+		for(size_t c=0; c<group_input_channels; c++)
+			for(size_t k=0; k<kernel_size; k++, i++)
+				permuted_weight[(k*group_input_channels + c)*output_channels + o] = weight[i];
+
+	// Create tensor for output
+	StdTensor<posit<nbits, es>> deltaN({batch_size, height, width, input_channels});
+
+#ifndef USING_LL_THREADS
+	convolution2d_input_gradient_channels_last_thread<nbits, es>(	delta, permuted_weight, deltaN, &rows, &cols,
+																	0, batch_size*height	);
+#else
+	// Distribute threads by samples and rows (see convolution2d_partition)
+	size_t const row_work = cols.kernel.size() * input_channels * (output_channels/groups) * rows.kernel.size() / ((height>0) ? height : 1);
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, 1, height,
+																row_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(convolution2d_input_gradient_channels_last_thread<nbits, es>,
+										std::cref(delta), std::cref(permuted_weight), std::ref(deltaN), &rows, &cols,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return deltaN;
+}
+
+// Sum of each channel of each sample of a channels last tensor, i.e. {N, H, W, C} to {N, C}
+// Same as sum_last2 with channels first
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> sum_spatial_channels_last(StdTensor<posit<nbits, es>> const& input){
+
+	size_t const batch_size = input.shape()[0];
+	size_t const size = input.shape()[1] * input.shape()[2];
+	size_t const channels = input.shape()[3];
+
+	StdTensor<posit<nbits, es>> output({batch_size, channels});
+	std::vector<Quire<nbits, es>> q(channels);
+
+	for(size_t n=0, i=0; n<batch_size; n++){
+		for(Quire<nbits, es>& qc : q)
+			qc.clear();
+
+		for(size_t idx=0; idx<size; idx++)
+			for(size_t c=0; c<channels; c++, i++)
+				q[c] += input[i];
+
+		for(size_t c=0; c<channels; c++)
+			convert(q[c].to_value(), output[n*channels + c]);
+	}
+
+	return output;
+}
+
+// Maximum pooling of channels last input for some units (output pixels of a sample, numbered through samples and pixels)
+// Same windows (and offsets of the maximums) as with channels first, for all channels of a pixel at once
+// With relu, maximums <= 0 are set to zero (and their offsets to RELU_ZERO)
+template <size_t nbits, size_t es, typename Offset>
+void maximumpool2d_channels_last_thread(	StdTensor<posit<nbits, es>> const& input,
+											StdTensor<posit<nbits, es>>& output,
+											Window const* w, Offset* max_offset, bool const relu,
+											size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_size = input.shape()[1] * input.shape()[2];
+	size_t const output_size = output.shape()[1] * output.shape()[2];
+	size_t const channels = input.shape()[3];
+
+	// Maximum of each channel, comparing posits as integers
+	std::vector<int64_t> max(channels);
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const idx = unit % output_size;
+		size_t const input_sample = (unit / output_size) * input_size;
+		size_t const output_idx = unit * channels;
+		size_t const begin = w->window_idx[idx];
+		size_t const end = w->window_idx[idx+1];
+
+		// If there is no overlap between input and kernel
+		if(begin == end) {
+			if(max_offset != NULL)
+				for(size_t c=0; c<channels; c++)
+					max_offset[output_idx+c] = no_maximum<Offset>();
+			continue;
+		}
+
+		// First maximum (like std::max_element)
+		size_t input_idx = (input_sample + w->map_window[begin]) * channels;
+
+		for(size_t c=0; c<channels; c++){
+			output[output_idx+c] = input[input_idx+c];
+			max[c] = posit_ordinal(input[input_idx+c]);
+			if(max_offset != NULL)
+				max_offset[output_idx+c] = 0;
+		}
+
+		for(size_t k=begin+1; k<end; k++){
+			input_idx = (input_sample + w->map_window[k]) * channels;
+
+			for(size_t c=0; c<channels; c++){
+				int64_t const value = posit_ordinal(input[input_idx+c]);
+				if(max[c] < value) {
+					max[c] = value;
+					output[output_idx+c] = input[input_idx+c];
+					if(max_offset != NULL)
+						max_offset[output_idx+c] = static_cast<Offset>(k - begin);
+				}
+			}
+		}
+
+		// ReLU (max<=0 also for NaR, like ReLU)
+		if(relu) {
+			for(size_t c=0; c<channels; c++){
+				if(max[c] <= 0){
+					output[output_idx+c].setzero();
+					if(max_offset != NULL)
+						max_offset[output_idx+c] = no_maximum<Offset>();	// RELU_ZERO
+				}
+			}
+		}
+	}
+}
+
+// Same as maximumpool2d for an input {batch, height, width, channels}
+// With relu, also applies ReLU to the output (see convolution2d_maximumpool2d_relu_channels_last)
+template <size_t nbits, size_t es, typename Offset=uint8_t>
+StdTensor<posit<nbits, es>> maximumpool2d_channels_last(	StdTensor<posit<nbits, es>> const& input,
+															size_t const kernel_size,
+															size_t const stride,
+															size_t const padding,
+															std::vector<Offset>* max_offset=NULL,
+															Window const* w=NULL,
+															bool const relu=false	){
+
+	check_maxpool2d_offsets<Offset>(kernel_size);
+
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(channels_first_shape(input.shape()), kernel_size, stride, padding);
+
+	// Get batch size and # of channels
+	size_t const batch_size = input.shape()[0];
+	size_t const channels = input.shape()[3];
+	size_t const output_size = w->output_height * w->output_width;
+
+	// Create tensor for output
+	StdTensor<posit<nbits, es>> output({batch_size, w->output_height, w->output_width, channels});
+	Offset* offsets = NULL;
+	if(max_offset != NULL) {
+		max_offset->resize(output.size());
+		offsets = max_offset->data();
+	}
+
+#ifndef USING_LL_THREADS
+	maximumpool2d_channels_last_thread<nbits, es, Offset>(input, output, w, offsets, relu, 0, batch_size*output_size);
+#else
+	// Distribute threads by samples and pixels (see convolution2d_partition)
+	size_t const pixel_work = kernel_size * kernel_size * channels;
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, 1, output_size,
+																pixel_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(maximumpool2d_channels_last_thread<nbits, es, Offset>,
+										std::cref(input), std::ref(output), w, offsets, relu,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return output;
+}
+
+// Backward of maximumpool2d_channels_last from the offsets of the maximums in their windows
+template <size_t nbits, size_t es, typename Offset>
+StdTensor<posit<nbits, es>> maximumpool2d_backward_channels_last(	StdTensor<posit<nbits, es>> const& deltaN,
+																	std::vector<size_t> const& input_shape,
+																	size_t const kernel_size, size_t const stride, size_t const padding,
+																	std::vector<Offset> const& max_offset,
+																	Window const& w	){
+
+	size_t const batch_size = input_shape[0];
+	size_t const input_size = input_shape[1] * input_shape[2];
+	size_t const output_size = deltaN.shape()[1] * deltaN.shape()[2];
+	size_t const channels = input_shape[3];
+
+	StdTensor<posit<nbits, es>> deltaN_1(input_shape);
+
+	// Windows don't overlap, so each delta goes to a different entry
+	if(stride >= kernel_size) {
+		for(size_t n=0, i=0; n<batch_size; n++) {
+			for(size_t idx=0; idx<output_size; idx++) {
+				for(size_t c=0; c<channels; c++, i++) {
+					if(max_offset[i] != no_maximum<Offset>())
+						deltaN_1[(n*input_size + w.map_window[w.window_idx[idx] + max_offset[i]])*channels + c] = deltaN[i];
+				}
+			}
+		}
+
+		return deltaN_1;
+	}
+
+	// Otherwise, sum the deltas of the outputs whose maximum is each input (in order of the outputs)
+	Window const& inverse = shared_window({	WindowMap::input_to_output, input_shape[1], input_shape[2],
+											kernel_size, kernel_size, stride, padding, 1, 1	});
+
+	std::vector<Quire<nbits, es>> q(channels);
+
+	for(size_t n=0, i=0; n<batch_size; n++) {
+		size_t const output_sample = n*output_size;
+
+		for(size_t idx=0; idx<input_size; idx++) {
+			for(Quire<nbits, es>& qc : q)
+				qc.clear();
+
+			for(size_t k=inverse.window_idx[idx]; k<inverse.window_idx[idx+1]; k++) {
+				size_t const output_idx = inverse.map_window[k];
+				size_t const window_begin = w.window_idx[output_idx];
+				size_t const delta_idx = (output_sample + output_idx)*channels;
+
+				for(size_t c=0; c<channels; c++) {
+					Offset const offset = max_offset[delta_idx+c];
+					if(offset != no_maximum<Offset>() && w.map_window[window_begin + offset] == idx)
+						q[c] += deltaN[delta_idx+c];
+				}
+			}
+
+			for(size_t c=0; c<channels; c++, i++)
+				convert(q[c].to_value(), deltaN_1[i]);
+		}
+	}
+
+	return deltaN_1;
+}
+
+// Same as convolution2d_maximumpool2d_relu with channels last
+// The output of the convolution is stored, since its channels of each pixel are computed together
+// Both passes are split between threads by samples and rows or pixels, with the ReLU in the pooling
+template <size_t nbits, size_t es, typename Offset>
+StdTensor<posit<nbits, es>> convolution2d_maximumpool2d_relu_channels_last(	StdTensor<posit<nbits, es>> const& input,
+																			StdTensor<posit<nbits, es>> const& weight,
+																			StdTensor<posit<nbits, es>> const& bias,
+																			size_t const stride,
+																			size_t const padding,
+																			size_t const dilation,
+																			size_t const pool_kernel_size,
+																			size_t const pool_stride,
+																			size_t const pool_padding,
+																			std::vector<Offset>* max_offset,
+																			Window const* pool_w=NULL	){
+
+	return maximumpool2d_channels_last(	convolution2d_channels_last(input, weight, bias, stride, padding, dilation),
+										pool_kernel_size, pool_stride, pool_padding, max_offset, pool_w, true	);
+}
+
+// Same as averagepool2d for channels last input for some units (output pixels of a sample)
+// Also used for the backward, with the input to output window
+template <size_t nbits, size_t es>
+void averagepool2d_channels_last_thread(	StdTensor<posit<nbits, es>> const& input,
+											StdTensor<posit<nbits, es>>& output,
+											Window const* w, size_t const kernel_total_size,
+											size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_size = input.shape()[1] * input.shape()[2];
+	size_t const output_size = output.shape()[1] * output.shape()[2];
+	size_t const channels = input.shape()[3];
+
+	// Initialize Quires
+	std::vector<Quire<nbits, es>> q(channels);
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const idx = unit % output_size;
+		size_t const input_sample = (unit / output_size) * input_size;
+		size_t const output_idx = unit * channels;
+		size_t const begin = w->window_idx[idx];
+		size_t const end = w->window_idx[idx+1];
+
+		// If there is no overlap between input and kernel
+		if(begin == end)
+			continue;
+
+		// Element only appears in 1 window
+		if(begin+1 == end){
+			size_t const input_idx = (input_sample + w->map_window[begin]) * channels;
+
+			for(size_t c=0; c<channels; c++)
+				output[output_idx+c] = input[input_idx+c];
+		}
+		// More than 1 element
+		else{
+			for(Quire<nbits, es>& qc : q)
+				qc.clear();
+
+			for(size_t k=begin; k<end; k++){
+				size_t const input_idx = (input_sample + w->map_window[k]) * channels;
+
+				for(size_t c=0; c<channels; c++)
+					q[c] += input[input_idx+c];
+			}
+
+			for(size_t c=0; c<channels; c++)
+				convert(q[c].to_value(), output[output_idx+c]);
+		}
+
+		for(size_t c=0; c<channels; c++)
+			output[output_idx+c] /= kernel_total_size;
+	}
+}
+
+// Average of the windows of an input {batch, height, width, channels} to an output with size of window
+template <size_t nbits, size_t es>
+void averagepool2d_channels_last_windows(	StdTensor<posit<nbits, es>> const& input,
+											StdTensor<posit<nbits, es>>& output,
+											Window const* w, size_t const kernel_size	){
+
+	size_t const batch_size = input.shape()[0];
+	size_t const output_size = output.shape()[1] * output.shape()[2];
+
+#ifndef USING_LL_THREADS
+	averagepool2d_channels_last_thread<nbits, es>(input, output, w, kernel_size*kernel_size, 0, batch_size*output_size);
+#else
+	// Distribute threads by samples and pixels (see convolution2d_partition)
+	size_t const pixel_work = kernel_size * kernel_size * input.shape()[3];
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, 1, output_size,
+																pixel_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(averagepool2d_channels_last_thread<nbits, es>,
+										std::cref(input), std::ref(output), w, kernel_size*kernel_size,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+}
+
+// Same as averagepool2d for an input {batch, height, width, channels}
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> averagepool2d_channels_last(	StdTensor<posit<nbits, es>> const& input,
+															size_t const kernel_size,
+															size_t const stride,
+															size_t const padding,
+															Window const* w=NULL	){
+
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(channels_first_shape(input.shape()), kernel_size, stride, padding);
+
+	StdTensor<posit<nbits, es>> output({input.shape()[0], w->output_height, w->output_width, input.shape()[3]});
+	averagepool2d_channels_last_windows(input, output, w, kernel_size);
+
+	return output;
+}
+
+// Same as averagepool2d_backward for channels last delta, with deltaN_1 of input_shape {batch, height, width, channels}
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> averagepool2d_backward_channels_last(	StdTensor<posit<nbits, es>> const& delta,
+																	std::vector<size_t> const& input_shape,
+																	size_t const kernel_size,
+																	size_t const stride,
+																	size_t const padding,
+																	Window const* w=NULL	){
+
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &shared_window({	WindowMap::input_to_output, input_shape[1], input_shape[2],
+								kernel_size, kernel_size, stride, padding, 1, 1	});
+
+	StdTensor<posit<nbits, es>> deltaN_1(input_shape);
+	averagepool2d_channels_last_windows(delta, deltaN_1, w, kernel_size);
+
+	return deltaN_1;
+}
+
+// Same as adaptive_averagepool2d_thread for channels last input for some units (output pixels of a sample)
+// The bin of each output pixel is reduced for all channels at once, reading the channels of each pixel contiguously
+template <size_t nbits, size_t es>
+void adaptive_averagepool2d_channels_last_thread(	StdTensor<posit<nbits, es>> const& input,
+													StdTensor<posit<nbits, es>>& output,
+													size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_height = input.shape()[1];
+	size_t const input_width = input.shape()[2];
+	size_t const output_height = output.shape()[1];
+	size_t const output_width = output.shape()[2];
+	size_t const channels = input.shape()[3];
+	size_t const output_size = output_height * output_width;
+
+	// Initialize Quires
+	std::vector<Quire<nbits, es>> q(channels);
+	size_t row_begin, row_end, col_begin, col_end;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const sample = unit / output_size;
+		size_t const idx = unit % output_size;
+		size_t const output_idx = unit * channels;
+
+		adaptive_pool_bin(idx / output_width, input_height, output_height, row_begin, row_end);
+		adaptive_pool_bin(idx % output_width, input_width, output_width, col_begin, col_end);
+
+		for(Quire<nbits, es>& qc : q)
+			qc.clear();
+
+		for(size_t row=row_begin; row<row_end; row++){
+			size_t input_idx = ((sample*input_height + row)*input_width + col_begin) * channels;
+
+			for(size_t col=col_begin; col<col_end; col++){
+				for(size_t c=0; c<channels; c++, input_idx++)
+					q[c] += input[input_idx];
+			}
+		}
+
+		size_t const bin_size = (row_end-row_begin) * (col_end-col_begin);
+		for(size_t c=0; c<channels; c++){
+			convert(q[c].to_value(), output[output_idx+c]);
+			output[output_idx+c] /= bin_size;
+		}
+	}
+}
+
+// Same as adaptive_averagepool2d_backward_thread for channels last delta for some units (samples)
+template <size_t nbits, size_t es>
+void adaptive_averagepool2d_backward_channels_last_thread(	StdTensor<posit<nbits, es>> const& delta,
+															StdTensor<posit<nbits, es>>& deltaN_1,
+															size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_height = deltaN_1.shape()[1];
+	size_t const input_width = deltaN_1.shape()[2];
+	size_t const output_height = delta.shape()[1];
+	size_t const output_width = delta.shape()[2];
+	size_t const channels = delta.shape()[3];
+
+	std::vector<posit<nbits, es>> value(channels);
+	size_t row_begin, row_end, col_begin, col_end;
+
+	// Loop through units
+	for(size_t sample=unit_begin; sample<unit_end; sample++){
+		size_t output_idx = sample * output_height * output_width * channels;
+
+		// Loop through output rows and cols
+		for(size_t i=0; i<output_height; i++){
+			adaptive_pool_bin(i, input_height, output_height, row_begin, row_end);
+
+			for(size_t j=0; j<output_width; j++, output_idx+=channels){
+				adaptive_pool_bin(j, input_width, output_width, col_begin, col_end);
+
+				size_t const bin_size = (row_end-row_begin) * (col_end-col_begin);
+				for(size_t c=0; c<channels; c++)
+					value[c] = delta[output_idx+c] / bin_size;
+
+				for(size_t row=row_begin; row<row_end; row++){
+					size_t input_idx = ((sample*input_height + row)*input_width + col_begin) * channels;
+
+					for(size_t col=col_begin; col<col_end; col++){
+						for(size_t c=0; c<channels; c++, input_idx++)
+							deltaN_1[input_idx] += value[c];
+					}
+				}
+			}
+		}
+	}
+}
+
+// Same as adaptive_averagepool2d for an input {batch, height, width, channels}
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> adaptive_averagepool2d_channels_last(	StdTensor<posit<nbits, es>> const& input,
+																	size_t const output_height, size_t const output_width	){
+
+	size_t const batch_size = input.shape()[0];
+
+	StdTensor<posit<nbits, es>> output({batch_size, output_height, output_width, input.shape()[3]});
+
+	parallel_units(	batch_size*output_height*output_width, adaptive_averagepool2d_channels_last_thread<nbits, es>,
+					std::cref(input), std::ref(output)	);
+
+	return output;
+}
+
+// Same as adaptive_averagepool2d_backward for channels last delta, with deltaN_1 of input_shape {batch, height, width, channels}
+// Bins of different outputs may overlap, so threads take different samples
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> adaptive_averagepool2d_backward_channels_last(	StdTensor<posit<nbits, es>> const& delta,
+																			std::vector<size_t> const& input_shape	){
+
+	StdTensor<posit<nbits, es>> deltaN_1(input_shape);
+
+	parallel_units(	input_shape[0], adaptive_averagepool2d_backward_channels_last_thread<nbits, es>,
+					std::cref(delta), std::ref(deltaN_1)	);
+
+	return deltaN_1;
+}
+
+#endif /* CHANNELS_LAST_HPP */
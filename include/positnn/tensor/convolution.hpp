@@ -11,6 +11,7 @@
 #ifdef USING_LL_THREADS
 #include <thread>
 #endif /* USING_LL_THREADS */
+#include <stdexcept>
 #include <universal/posit/posit>
 #include <vector>
 
@@ -22,6 +23,82 @@
 // Namespaces
 using namespace sw::unum;
 
+// Grouped convolutions: channels are split in groups and each output channel only depends on the
+// input channels of its group, so the weight has in_channels/groups input channels
+// (depthwise convolution when groups = in_channels)
+// Checks that the input has weight_input_channels*groups channels and returns the output channels of each group
+inline size_t convolution2d_groups(	size_t const input_channels, size_t const weight_input_channels,
+									size_t const output_channels, size_t const groups	){
+
+	if(groups==0 || output_channels % groups != 0)
+		throw std::invalid_argument( "channels of output of convolution should be divisible by the groups" );
+
+	if(input_channels != weight_input_channels*groups)
+		throw std::invalid_argument( "channels of input of convolution should be the channels of the weight times the groups" );
+
+	return output_channels / groups;
+}
+
+// Algorithm for a convolution with an implicit window (see Window::implicit_output_to_input)
+// Same order of operations as with the stored window
+// Optionally, only for kernel rows [row_begin, row_end)
+template <size_t nbits, size_t es>
+void do_convolution_implicit(	StdTensor<posit<nbits, es>> const& input,
+								StdTensor<posit<nbits, es>> const& kernel,
+								Quire<nbits, es>& output, Window const& w,
+								size_t const input_idx, size_t const kernel_idx, size_t const idx,
+								size_t const row_begin=0, size_t row_end=static_cast<size_t>(-1)	){
+
+	if(row_end > w.kernel_height)
+		row_end = w.kernel_height;
+
+	// Output row and col
+	size_t const row = idx / w.output_width;
+	size_t const col = idx % w.output_width;
+
+	// Position of the window in the padded input
+	size_t const row0 = row * w.stride;
+	size_t const col0 = col * w.stride;
+
+	size_t const input_row_stride = w.dilation * w.input_width;
+	size_t kernel_i = kernel_idx + row_begin*w.kernel_width;
+
+	// Interior: whole window is inside the input, so no bounds checks
+	if(	row >= w.interior_row_begin && row < w.interior_row_end &&
+		col >= w.interior_col_begin && col < w.interior_col_end	){
+
+		size_t input_row = input_idx + (row0 - w.padding)*w.input_width + (col0 - w.padding) + row_begin*input_row_stride;
+
+		for(size_t x=row_begin; x<row_end; x++){
+			for(size_t y=0, input_i=input_row; y<w.kernel_width; y++, input_i+=w.dilation)
+				output += Quire_mul(input[input_i], kernel[kernel_i++]);
+
+			input_row += input_row_stride;
+		}
+
+		return;
+	}
+
+	// Border: skip the kernel elements over the padding
+	for(size_t x=row_begin, m=row0+row_begin*w.dilation; x<row_end; x++, m+=w.dilation){
+		if(m < w.padding || m - w.padding >= w.input_height){
+			kernel_i += w.kernel_width;
+			continue;
+		}
+
+		size_t const input_row = input_idx + (m - w.padding)*w.input_width;
+
+		for(size_t y=0, n=col0; y<w.kernel_width; y++, n+=w.dilation, kernel_i++){
+			if(n < w.padding || n - w.padding >= w.input_width)
+				continue;
+
+			output += Quire_mul(input[input_row + n - w.padding], kernel[kernel_i]);
+		}
+	}
+
+	return;
+}
+
 // Algorithm for a convolution
 template <size_t nbits, size_t es>
 void do_convolution(StdTensor<posit<nbits, es>> const& input,
@@ -29,6 +106,11 @@ void do_convolution(StdTensor<posit<nbits, es>> const& input,
 					Quire<nbits, es>& output, Window const& w,
 					size_t const input_idx, size_t const kernel_idx, size_t const idx){
 
+	if(w.implicit){
+		do_convolution_implicit(input, kernel, output, w, input_idx, kernel_idx, idx);
+		return;
+	}
+
 	// Begin and end element to operate (multiply)
 	size_t const begin = w.window_idx[idx];
 	size_t const end = w.window_idx[idx+1];
@@ -50,14 +132,64 @@ void do_convolution(StdTensor<posit<nbits, es>> const& input,
 
 #ifdef USING_LL_THREADS
 
+// Multiply-accumulates under which it isn't worth to start another thread
+size_t const CONVOLUTION_MIN_THREAD_WORK = 1 << 14;
+
+// Split the output of convolution2d between threads
+// The output is divided in units (rows of an output channel of a sample), numbered through
+// samples, output channels and rows, and each thread gets a contiguous range of units
+// Cost model: each unit costs row_work multiply-accumulates, so fewer threads are used if each
+// wouldn't get min_work. The split is between samples if there are enough of them to balance
+// the threads (within 1/8), else between output channels (e.g. batch of 1), else between rows
+// Returns the first unit of each thread and the total # of units
+inline std::vector<size_t> convolution2d_partition(	size_t const batch_size, size_t const channels, size_t const rows,
+													size_t const row_work, size_t max_threads,
+													size_t const min_work=CONVOLUTION_MIN_THREAD_WORK	){
+
+	size_t const units = batch_size * channels * rows;
+
+	// Limit threads by their work
+	size_t const work = units * row_work;
+	size_t const worth_threads = (min_work>0) ? work / min_work : units;
+	if(worth_threads < max_threads)
+		max_threads = (worth_threads>0) ? worth_threads : 1;
+	if(units < max_threads)
+		max_threads = (units>0) ? units : 1;
+
+	// Choose coarsest split that balances threads
+	size_t const granularities[3] = {channels*rows, rows, 1};
+	size_t granularity = 1;
+
+	for(size_t const g : granularities) {
+		if(g == 0)
+			break;
+
+		size_t const n = units / g;
+		size_t const per_thread = (n + max_threads - 1) / max_threads;
+
+		if(n >= max_threads && (per_thread*max_threads - n) * 8 <= n) {
+			granularity = g;
+			break;
+		}
+	}
+
+	// Distribute blocks of that granularity as evenly as possible
+	size_t const n = (granularity>0) ? units / granularity : 0;
+	std::vector<size_t> begin(max_threads+1);
+
+	for(size_t t=0; t<=max_threads; t++)
+		begin[t] = (t * n / max_threads) * granularity;
+
+	return begin;
+}
+
 template <size_t nbits, size_t es>
 void convolution2d_thread(	StdTensor<posit<nbits, es>> const& input,
 							StdTensor<posit<nbits, es>> const& weight,
 							StdTensor<posit<nbits, es>> const& bias,
 							StdTensor<posit<nbits, es>>& output,
-							Window const* w,
-							size_t input_batch, size_t output_batch,
-							size_t const n_samples	){
+							Window const* w, size_t const groups,
+							size_t const unit_begin, size_t const unit_end	){
 	
 	// Check if bias is empty
 	bool const no_bias = bias.empty();
@@ -69,59 +201,74 @@ void convolution2d_thread(	StdTensor<posit<nbits, es>> const& input,
 	// Strides to loop tensors
 	size_t const input_batch_stride = input.strides()[0];
 	size_t const input_channel_stride = input.strides()[1];
-	size_t const output_batch_stride = output.strides()[0];
 	size_t const output_channel_stride = output.strides()[1];
 	size_t const weight_out_channel_stride = weight.strides()[0];
 	size_t const weight_in_channel_stride = weight.strides()[1];
 
-	// Size of output matrix after convolution
-	size_t const size = output_channel_stride;
+	// Output channels of each group and stride between the input channels of groups
+	size_t const group_channels = output_channels / groups;
+	size_t const group_stride = input_channels * input_channel_stride;
+
+	// Size of output rows
+	size_t const rows = w->output_height;
+	size_t const cols = w->output_width;
 
 	// Initialize Quire
 	Quire<nbits, es> q;
 
-	// Loop through batch
-	for(size_t i=0; i<n_samples; i++){
-		size_t weight_out_channel = 0;
-		size_t output_channel = output_batch;
+	// Indices of first unit (output row of an output channel of a sample)
+	size_t row = unit_begin % rows;
+	size_t j = (unit_begin / rows) % output_channels;
+	size_t input_batch = (unit_begin / rows / output_channels) * input_batch_stride;
+	size_t weight_out_channel = j * weight_out_channel_stride;
+	size_t output_channel = (unit_begin / rows) * output_channel_stride;
 
-		// Loop through output channels
-		for(size_t j=0; j<output_channels; j++){
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
 
-			// Loop through output rows and cols
-			for(size_t idx=0; idx<size; idx++){
+		// First input channel of the group of this output channel
+		size_t const input_group = input_batch + (j / group_channels) * group_stride;
 
-				// Indices of input and weight for input channel
-				size_t input_channel = input_batch;
-				size_t weight_in_channel = weight_out_channel;
-	
-				// Set Quire to bias value
-				if(no_bias)
-					q.clear();
-				else
-					q = bias[j];
+		// Loop through cols of output row
+		for(size_t idx=row*cols, idx_end=idx+cols; idx<idx_end; idx++){
 
-				// Loop through input channels
-				for(size_t channel=0; channel<input_channels; channel++){
-					// Compute convolution for that block
-					do_convolution(	input, weight, q, *w,
-									input_channel, weight_in_channel, idx	);
+			// Indices of input and weight for input channel
+			size_t input_channel = input_group;
+			size_t weight_in_channel = weight_out_channel;
 
-					// Loop through input channels
-					input_channel += input_channel_stride;
-					weight_in_channel += weight_in_channel_stride;
-				}
-				
-				// Convert result from Quire to posit
-				convert(q.to_value(), output[output_channel+idx]);
+			// Set Quire to bias value
+			if(no_bias)
+				q.clear();
+			else
+				q = bias[j];
+
+			// Loop through input channels
+			for(size_t channel=0; channel<input_channels; channel++){
+				// Compute convolution for that block
+				do_convolution(	input, weight, q, *w,
+								input_channel, weight_in_channel, idx	);
+
+				// Loop through input channels
+				input_channel += input_channel_stride;
+				weight_in_channel += weight_in_channel_stride;
 			}
-				
-			weight_out_channel += weight_out_channel_stride;
-			output_channel += output_channel_stride;
+			
+			// Convert result from Quire to posit
+			convert(q.to_value(), output[output_channel+idx]);
 		}
 
-		input_batch += input_batch_stride;
-		output_batch += output_batch_stride;
+		// Go to next row, output channel or sample
+		if(++row == rows) {
+			row = 0;
+			output_channel += output_channel_stride;
+			weight_out_channel += weight_out_channel_stride;
+
+			if(++j == output_channels) {
+				j = 0;
+				weight_out_channel = 0;
+				input_batch += input_batch_stride;
+			}
+		}
 	}
 }
 
@@ -133,79 +280,46 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 											size_t const padding=0,
 											size_t const dilation_input=1,
 											size_t const dilation_kernel=1,
-											Window* w=NULL ){
+											size_t const groups=1,
+											Window const* w=NULL,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>() ){
 	
-	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 	
-	// Get windows
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							weight.shape()[2], weight.shape()[3],
-							stride, padding, dilation_input, dilation_kernel	);
-	}
+	// Get windows (shared with other convolutions of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &convolution2d_window(input.shape(), weight.shape(), stride, padding, dilation_input, dilation_kernel);
 
 	// Get batch size and # of output channels
 	size_t const batch_size = input.shape()[0];
 	size_t const output_channels = weight.shape()[0];
 
-	// Create tensor for output
-	StdTensor<posit<nbits, es>> output({batch_size, output_channels, w->output_height, w->output_width});
+	// Check groups before starting threads
+	convolution2d_groups(input.shape()[1], weight.shape()[1], output_channels, groups);
 
-	// Strides to loop tensors
-	size_t const input_batch_stride = input.strides()[0];
-	size_t const output_batch_stride = output.strides()[0];
+	// Create tensor for output (in the memory of storage, see StdTensor::reuse)
+	StdTensor<posit<nbits, es>> output = std::move(storage);
+	output.reuse({batch_size, output_channels, w->output_height, w->output_width});
 
-	// Distribute threads (each thread will take care of the same # of samples)
-	const size_t max_threads = (LL_THREADS<batch_size) ? LL_THREADS : batch_size;
+	// Distribute threads by samples, output channels and rows (see convolution2d_partition)
+	size_t const row_work = w->output_width * weight.shape()[1] * weight.strides()[1];
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, output_channels, w->output_height,
+																row_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
 	std::vector<std::thread> threads;
 	threads.reserve(max_threads);
 
-	// Calculate load for each thread
-	size_t const n_samples = batch_size / max_threads;
-	size_t const nthreads_more = batch_size % max_threads;
-
-	// Strides to jump between threads' samples
-	size_t const input_samples_stride = n_samples * input_batch_stride; 
-	size_t const output_samples_stride = n_samples * output_batch_stride; 
-
-	// Start at first sample
-	size_t input_samples_begin = 0;
-	size_t output_samples_begin = 0;
-
 	for(size_t t=0; t<max_threads; t++){
-
-		// Get number of samples for this thread
-		size_t thread_samples = n_samples;
-		if(t < nthreads_more)
-			thread_samples++;
-
 		threads.push_back(std::thread(convolution2d_thread<nbits, es>,
-										std::cref(input), std::cref(weight), std::cref(bias), std::ref(output), w,
-										input_samples_begin, output_samples_begin, thread_samples	));
-		
-		// Go to next samples
-		input_samples_begin += input_samples_stride;
-		output_samples_begin += output_samples_stride;
-
-		if(t < nthreads_more){
-			input_samples_begin += input_batch_stride;
-			output_samples_begin += output_batch_stride;
-		}
+										std::cref(input), std::cref(weight), std::cref(bias), std::ref(output), w, groups,
+										begin[t], begin[t+1]	));
 	}
 	
 	for(std::thread& t : threads) {
 		t.join();
 	}	
 
-	if(empty)
-		delete w;
-
 	return output;
 
 }
@@ -220,21 +334,15 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 											size_t const padding=0,
 											size_t const dilation_input=1,
 											size_t const dilation_kernel=1,
-											Window* w=NULL ){
+											size_t const groups=1,
+											Window const* w=NULL,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>() ){
 	
-	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							weight.shape()[2], weight.shape()[3],
-							stride, padding, dilation_input, dilation_kernel	);
-	}
+	// Get windows (shared with other convolutions of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &convolution2d_window(input.shape(), weight.shape(), stride, padding, dilation_input, dilation_kernel);
 
 	// Check if bias is empty
 	bool const no_bias = bias.empty();
@@ -243,7 +351,8 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 	size_t const output_channels = weight.shape()[0];
 	size_t const input_channels = weight.shape()[1];
 
-	StdTensor<posit<nbits, es>> output({batch_size, output_channels, w->output_height, w->output_width});
+	StdTensor<posit<nbits, es>> output = std::move(storage);
+	output.reuse({batch_size, output_channels, w->output_height, w->output_width});
 
 	size_t const input_batch_stride = input.strides()[0];
 	size_t const input_channel_stride = input.strides()[1];
@@ -252,6 +361,10 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 	size_t const output_batch_stride = output.strides()[0];
 	size_t const output_channel_stride = output.strides()[1];
 
+	// Output channels of each group and stride between the input channels of groups
+	size_t const group_channels = convolution2d_groups(input.shape()[1], input_channels, output_channels, groups);
+	size_t const group_stride = input_channels * input_channel_stride;
+
 	size_t const size = output_channel_stride;
 
 	size_t input_batch = 0;
@@ -268,11 +381,14 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 		// Loop through output channels
 		for(size_t j=0; j<output_channels; j++){
 
+			// First input channel of the group of this output channel
+			size_t const input_group = input_batch + (j / group_channels) * group_stride;
+
 			// Loop through output rows and cols
 			for(size_t idx=0; idx<size; idx++){
 
 				// Indices of input and weight for input channel
-				size_t input_channel = input_batch;
+				size_t input_channel = input_group;
 				size_t weight_in_channel = weight_out_channel;
 	
 				// Set Quire to bias value
@@ -303,9 +419,6 @@ StdTensor<posit<nbits, es>> convolution2d(	StdTensor<posit<nbits, es>> const& in
 		output_batch += output_batch_stride;
 	}
 
-	if(empty)
-		delete w;
-
 	return output;
 }
 
@@ -317,13 +430,13 @@ template <size_t nbits, size_t es>
 void convolution2d_gradient_thread(	StdTensor<posit<nbits, es>> const& input,
 									StdTensor<posit<nbits, es>> const& delta,
 									StdTensor<posit<nbits, es>>& dweight,
-									Window const* w,
+									Window const* w, size_t const groups,
 									size_t const dweight_begin, size_t const n_samples	){
 
 	//std::cout << "dweight_begin: " << dweight_begin << std::endl;
 
 	size_t const batch_size = input.shape()[0];
-	size_t const input_channels = input.shape()[1];
+	size_t const input_channels = dweight.shape()[1];
 	size_t const output_channels = delta.shape()[1];
 	
 	// Strides to loop tensors
@@ -332,6 +445,10 @@ void convolution2d_gradient_thread(	StdTensor<posit<nbits, es>> const& input,
 	size_t const delta_batch_stride = delta.strides()[0];
 	size_t const delta_channel_stride = delta.strides()[1];
 
+	// Output channels of each group and stride between the input channels of groups
+	size_t const group_channels = output_channels / groups;
+	size_t const group_stride = input_channels * input_channel_stride;
+
 	size_t const size = dweight.strides()[1];
 
 	//std::cout << "strides: " << dweight.strides() << std::endl;
@@ -364,8 +481,8 @@ void convolution2d_gradient_thread(	StdTensor<posit<nbits, es>> const& input,
 	// Loop through output (delta) channels
 	for(size_t i=out_channel0; i<output_channels; i++){
 
-		// Index of input channel
-		size_t input_channel = (first) ? input_channel0 : 0;
+		// Index of input channel (in the group of this output channel)
+		size_t input_channel = (i / group_channels) * group_stride + ((first) ? input_channel0 : 0);
 		
 		// Loop through input channels
 		for(size_t j = (first) ? in_channel0 : 0; j<input_channels; j++){
@@ -410,6 +527,108 @@ void convolution2d_gradient_thread(	StdTensor<posit<nbits, es>> const& input,
 	}
 }
 
+#if defined(QUIRE_MODE) && QUIRE_MODE>0
+
+// Memory for the quires of the partial gradients of all threads (see convolution2d_gradient)
+size_t const CONVOLUTION_GRADIENT_QUIRE_MEMORY = 64 << 20;
+
+// Partial gradient of the weights of output channels [channel_begin, channel_end) for some units
+// (part of the spatial extent of a sample)
+// Each sample's input and delta are read while they are in cache, accumulating to the
+// thread's quires (one per element of dweight of those channels)
+template <size_t nbits, size_t es>
+void convolution2d_gradient_partial_thread(	StdTensor<posit<nbits, es>> const& input,
+											StdTensor<posit<nbits, es>> const& delta,
+											std::vector<Quire<nbits, es>>& partial,
+											Window const* w, size_t const groups, size_t const parts,
+											size_t const channel_begin, size_t const channel_end,
+											size_t const unit_begin, size_t const unit_end	){
+
+	size_t const input_channels = input.shape()[1] / groups;
+	size_t const output_channels = delta.shape()[1];
+	size_t const group_channels = output_channels / groups;
+
+	// Size of weights matrix
+	size_t const size = w->output_height * w->output_width;
+
+	for(size_t n=0, n_end=(channel_end-channel_begin)*input_channels*size; n<n_end; n++)
+		partial[n].clear();
+
+	// Strides to loop tensors
+	size_t const input_batch_stride = input.strides()[0];
+	size_t const input_channel_stride = input.strides()[1];
+	size_t const delta_batch_stride = delta.strides()[0];
+	size_t const delta_channel_stride = delta.strides()[1];
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const batch = unit / parts;
+		size_t const part = unit % parts;
+
+		size_t delta_channel = batch * delta_batch_stride + channel_begin * delta_channel_stride;
+		size_t n = 0;
+
+		// Loop through output (delta) channels
+		for(size_t i=channel_begin; i<channel_end; i++){
+
+			// Index of input channel (in the group of this output channel)
+			size_t input_channel = batch * input_batch_stride + (i / group_channels) * input_channels * input_channel_stride;
+
+			// Loop through input channels
+			for(size_t j=0; j<input_channels; j++){
+
+				// Loop through weights rows and cols
+				for(size_t idx=0; idx<size; idx++){
+
+					// Part of the window of this unit (rows of delta for implicit windows)
+					if(w->implicit){
+						do_convolution_implicit(	input, delta, partial[n], *w, input_channel, delta_channel, idx,
+													w->kernel_height*part/parts, w->kernel_height*(part+1)/parts	);
+						n++;
+						continue;
+					}
+
+					size_t const begin = w->window_idx[idx];
+					size_t const length = w->window_idx[idx+1] - begin;
+					size_t const k_end = begin + length*(part+1)/parts;
+
+					for(size_t k=begin + length*part/parts; k<k_end; k++){
+						partial[n] += Quire_mul(input[input_channel + w->map_window[k]],
+												delta[delta_channel + w->kernel_window[k]]);
+					}
+
+					n++;
+				}
+
+				input_channel += input_channel_stride;
+			}
+
+			delta_channel += delta_channel_stride;
+		}
+	}
+}
+
+// Add partial gradients of the threads (exactly, with quires) for elements [begin, end) of the partials,
+// which are the elements offset+[begin, end) of dweight
+template <size_t nbits, size_t es>
+void convolution2d_gradient_merge_thread(	std::vector<std::vector<Quire<nbits, es>>> const& partials,
+											StdTensor<posit<nbits, es>>& dweight, size_t const offset,
+											size_t const begin, size_t const end	){
+
+	Quire<nbits, es> q;
+
+	for(size_t n=begin; n<end; n++){
+		q = partials[0][n];
+
+		for(size_t t=1; t<partials.size(); t++)
+			q += partials[t][n];
+
+		convert(q.to_value(), dweight[offset+n]);
+	}
+}
+
+#endif /* QUIRE_MODE */
+
 template <size_t nbits, size_t es>
 StdTensor<posit<nbits, es>> convolution2d_gradient(
 												StdTensor<posit<nbits, es>> const& input,
@@ -417,29 +636,95 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 												size_t const stride=1,
 												size_t const padding=0,
 												size_t const dilation=1,
-												Window* w=NULL ){
+												size_t const groups=1,
+												Window const* w=NULL ){
 	
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 	
-	bool empty = (w==NULL);
+	// Get windows (shared with other convolutions of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &shared_window({	WindowMap::implicit_output_to_input, input.shape()[2], input.shape()[3],
+								delta.shape()[2], delta.shape()[3], dilation, padding, 1, stride	});
 
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							delta.shape()[2], delta.shape()[3],
-							dilation, padding, 1, stride	);
-	}
-
-	size_t const input_channels = input.shape()[1];
+	size_t const input_channels = (groups>0) ? input.shape()[1] / groups : 0;
 	size_t const output_channels = delta.shape()[1];
+	convolution2d_groups(input.shape()[1], input_channels, output_channels, groups);
 
 	StdTensor<posit<nbits, es>> dweight({output_channels, input_channels, w->output_height, w->output_width});
 
 	size_t const size = dweight.size();
 
+#if defined(QUIRE_MODE) && QUIRE_MODE>0
+	// Distribute threads by samples (and by parts of their spatial extent if there are less samples than threads)
+	// Each thread accumulates to its own quires, which are then added exactly, so the result is the same
+	// as accumulating the whole batch in a single quire
+	size_t const batch_size = input.shape()[0];
+	size_t const work = size * batch_size * delta.shape()[2] * delta.shape()[3];
+	size_t const worth_threads = work / CONVOLUTION_MIN_THREAD_WORK;
+
+	size_t max_threads = (LL_THREADS<worth_threads) ? LL_THREADS : worth_threads;
+	if(max_threads == 0)
+		max_threads = 1;
+
+	size_t const parts = (batch_size>0 && batch_size<max_threads) ? (max_threads+batch_size-1)/batch_size : 1;
+	size_t const units = batch_size * parts;
+	if(units>0 && units<max_threads)
+		max_threads = units;
+
+	// The quires of all threads are limited to CONVOLUTION_GRADIENT_QUIRE_MEMORY, so dweight is computed
+	// in tiles of output channels (e.g. 512x512x3x3 with 8 threads needs 19M quires, so it takes several tiles)
+	// Fewer threads are used only if a single output channel doesn't fit
+	size_t const channel_size = dweight.strides()[0];
+	size_t const channel_memory = channel_size * sizeof(Quire<nbits, es>);
+	size_t const memory_threads = CONVOLUTION_GRADIENT_QUIRE_MEMORY / ((channel_memory>0) ? channel_memory : 1);
+
+	if(memory_threads < max_threads)
+		max_threads = (memory_threads>0) ? memory_threads : 1;
+
+	size_t tile_channels = CONVOLUTION_GRADIENT_QUIRE_MEMORY / (max_threads * ((channel_memory>0) ? channel_memory : 1));
+	if(tile_channels == 0)
+		tile_channels = 1;
+	if(tile_channels > output_channels)
+		tile_channels = output_channels;
+
+	std::vector<std::vector<Quire<nbits, es>>> partials(max_threads, std::vector<Quire<nbits, es>>(tile_channels*channel_size));
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t channel_begin=0; channel_begin<output_channels; channel_begin+=tile_channels){
+		size_t const channel_end = (channel_begin+tile_channels < output_channels) ? channel_begin+tile_channels : output_channels;
+		size_t const tile_size = (channel_end-channel_begin) * channel_size;
+
+		for(size_t t=0; t<max_threads; t++){
+			threads.push_back(std::thread(convolution2d_gradient_partial_thread<nbits, es>,
+											std::cref(input), std::cref(delta), std::ref(partials[t]), w, groups, parts,
+											channel_begin, channel_end,
+											t*units/max_threads, (t+1)*units/max_threads	));
+		}
+
+		for(std::thread& t : threads) {
+			t.join();
+		}
+
+		threads.clear();
+
+		// Merge partial gradients, each thread taking care of the same # of elements
+		size_t const merge_threads = (max_threads<tile_size) ? max_threads : ((tile_size>0) ? tile_size : 1);
+
+		for(size_t t=0; t<merge_threads; t++){
+			threads.push_back(std::thread(convolution2d_gradient_merge_thread<nbits, es>,
+											std::cref(partials), std::ref(dweight), channel_begin*channel_size,
+											t*tile_size/merge_threads, (t+1)*tile_size/merge_threads	));
+		}
+
+		for(std::thread& t : threads) {
+			t.join();
+		}
+
+		threads.clear();
+	}
+#else
 	// Distribute threads (each thread will take care of the same # of samples)
 	const size_t max_threads = (LL_THREADS<size) ? LL_THREADS : size;
 	std::vector<std::thread> threads;
@@ -460,7 +745,7 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 			thread_samples++;
 
 		threads.push_back(std::thread(convolution2d_gradient_thread<nbits, es>,
-										std::cref(input), std::cref(delta), std::ref(dweight), w,
+										std::cref(input), std::cref(delta), std::ref(dweight), w, groups,
 										dweight_begin, thread_samples	));
 		
 		// Go to next dweight element
@@ -470,9 +755,7 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 	for(std::thread& t : threads) {
 		t.join();
 	}
-
-	if(empty)
-		delete w;
+#endif /* QUIRE_MODE */
 
 	return dweight;
 
@@ -487,25 +770,21 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 												size_t const stride=1,
 												size_t const padding=0,
 												size_t const dilation=1,
-												Window* w=NULL ){
+												size_t const groups=1,
+												Window const* w=NULL ){
 	
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
 	
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							delta.shape()[2], delta.shape()[3],
-							dilation, padding, 1, stride	);
-	}
+	// Get windows (shared with other convolutions of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &shared_window({	WindowMap::implicit_output_to_input, input.shape()[2], input.shape()[3],
+								delta.shape()[2], delta.shape()[3], dilation, padding, 1, stride	});
 
 	size_t const batch_size = input.shape()[0];
-	size_t const input_channels = input.shape()[1];
+	size_t const input_channels = (groups>0) ? input.shape()[1] / groups : 0;
 	size_t const output_channels = delta.shape()[1];
+	size_t const group_channels = convolution2d_groups(input.shape()[1], input_channels, output_channels, groups);
 
 	StdTensor<posit<nbits, es>> dweight({output_channels, input_channels, w->output_height, w->output_width});
 
@@ -525,8 +804,8 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 	// Loop through output (delta) channels
 	for(size_t i=0; i<output_channels; i++){
 		
-		// Index of input channel
-		size_t input_channel = 0;
+		// Index of input channel (in the group of this output channel)
+		size_t input_channel = (i / group_channels) * input_channels * input_channel_stride;
 
 		// Loop through input channels
 		for(size_t j=0; j<input_channels; j++){
@@ -562,14 +841,174 @@ StdTensor<posit<nbits, es>> convolution2d_gradient(
 		delta_channel += delta_channel_stride;
 	}
 
-	if(empty)
-		delete w;
-
 	return dweight;
 }
 
 #endif /* USING_LL_THREADS */
 
+// Positions of the kernel and of the output of a convolution that each position of its input
+// was multiplied with, along one dimension (rows or cols)
+// Only positions in the same phase of the stride are visited, so there are no holes to skip
+struct TransposedTaps{
+	// Index of the first tap of each input position (plus one to store the size)
+	std::vector<size_t> begin;
+
+	// Kernel and output positions of each tap
+	std::vector<size_t> kernel;
+	std::vector<size_t> output;
+
+	void init(	size_t const input_size, size_t const output_size, size_t const kernel_size,
+				size_t const stride=1, size_t const padding=0, size_t const dilation=1	){
+
+		begin.clear();
+		kernel.clear();
+		output.clear();
+
+		begin.reserve(input_size+1);
+
+		for(size_t y=0; y<input_size; y++){
+			begin.push_back(kernel.size());
+
+			// Kernel positions with y+padding-k*dilation multiple of stride
+			// (last first, like the convolution with the rotated kernel)
+			for(size_t k=kernel_size; k-->0; ){
+				if(y+padding < k*dilation)
+					continue;
+
+				size_t const position = y + padding - k*dilation;
+				if(position % stride != 0 || position/stride >= output_size)
+					continue;
+
+				kernel.push_back(k);
+				output.push_back(position/stride);
+			}
+		}
+
+		begin.push_back(kernel.size());
+	}
+};
+
+// Gradient of convolution2d with respect to its input (transposed convolution) for some units
+// (rows of an input channel of a sample, numbered through samples, channels and rows)
+template <size_t nbits, size_t es>
+void convolution2d_input_gradient_thread(	StdTensor<posit<nbits, es>> const& delta,
+											StdTensor<posit<nbits, es>> const& weight,
+											StdTensor<posit<nbits, es>>& deltaN,
+											TransposedTaps const* rows, TransposedTaps const* cols,
+											size_t const unit_begin, size_t const unit_end	){
+
+	// Get number of input and output channels (of each group)
+	size_t const input_channels = deltaN.shape()[1];
+	size_t const group_input_channels = weight.shape()[1];
+	size_t const group_channels = weight.shape()[0] / (input_channels / group_input_channels);
+	size_t const kernel_width = weight.shape()[3];
+
+	// Strides to loop tensors
+	size_t const delta_batch_stride = delta.strides()[0];
+	size_t const delta_channel_stride = delta.strides()[1];
+	size_t const delta_width = delta.shape()[3];
+	size_t const weight_out_channel_stride = weight.strides()[0];
+	size_t const weight_in_channel_stride = weight.strides()[1];
+
+	// Size of deltaN
+	size_t const height = deltaN.shape()[2];
+	size_t const width = deltaN.shape()[3];
+
+	// Initialize Quire
+	Quire<nbits, es> q;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+		size_t const y = unit % height;
+		size_t const c = (unit / height) % input_channels;
+		size_t const delta_batch = (unit / height / input_channels) * delta_batch_stride;
+		size_t const group = c / group_input_channels;
+		size_t n = unit * width;
+
+		// Loop through cols
+		for(size_t x=0; x<width; x++){
+			size_t delta_channel = delta_batch + group * group_channels * delta_channel_stride;
+			size_t weight_channel = group * group_channels * weight_out_channel_stride +
+									(c % group_input_channels) * weight_in_channel_stride;
+
+			q.clear();
+
+			// Loop through output channels of the convolution (in the group of this input channel)
+			for(size_t o=0; o<group_channels; o++){
+
+				// Loop through taps of this row and col
+				for(size_t r=rows->begin[y]; r<rows->begin[y+1]; r++){
+					size_t const delta_row = delta_channel + rows->output[r]*delta_width;
+					size_t const weight_row = weight_channel + rows->kernel[r]*kernel_width;
+
+					for(size_t s=cols->begin[x]; s<cols->begin[x+1]; s++){
+						q += Quire_mul(	delta[delta_row + cols->output[s]],
+										weight[weight_row + cols->kernel[s]]	);
+					}
+				}
+
+				delta_channel += delta_channel_stride;
+				weight_channel += weight_out_channel_stride;
+			}
+
+			// Convert result from Quire to posit
+			convert(q.to_value(), deltaN[n++]);
+		}
+	}
+}
+
+// Gradient of convolution2d with respect to its input, with shape {batch, in_channels, height, width}
+// Same as the convolution of the dilated and padded delta with the rotated weight, but indexes the
+// weight in place and only visits the kernel positions that overlap the delta
+template <size_t nbits, size_t es>
+StdTensor<posit<nbits, es>> convolution2d_input_gradient(	StdTensor<posit<nbits, es>> const& delta,
+															StdTensor<posit<nbits, es>> const& weight,
+															size_t const height, size_t const width,
+															size_t const stride=1,
+															size_t const padding=0,
+															size_t const dilation=1,
+															size_t const groups=1	){
+
+	// Get batch size and # of input channels
+	size_t const batch_size = delta.shape()[0];
+	size_t const input_channels = weight.shape()[1] * groups;
+	convolution2d_groups(input_channels, weight.shape()[1], weight.shape()[0], groups);
+
+	// Taps of rows and cols
+	TransposedTaps rows, cols;
+	rows.init(height, delta.shape()[2], weight.shape()[2], stride, padding, dilation);
+	cols.init(width, delta.shape()[3], weight.shape()[3], stride, padding, dilation);
+
+	// Create tensor for output
+	StdTensor<posit<nbits, es>> deltaN({batch_size, input_channels, height, width});
+
+#ifndef USING_LL_THREADS
+	convolution2d_input_gradient_thread<nbits, es>(	delta, weight, deltaN, &rows, &cols,
+													0, batch_size*input_channels*height	);
+#else
+	// Distribute threads by samples, input channels and rows (see convolution2d_partition)
+	size_t const row_work = cols.kernel.size() * (weight.shape()[0]/groups) * rows.kernel.size() / ((height>0) ? height : 1);
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, input_channels, height,
+																row_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(convolution2d_input_gradient_thread<nbits, es>,
+										std::cref(delta), std::cref(weight), std::ref(deltaN), &rows, &cols,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return deltaN;
+}
+
 template <typename T>
 StdTensor<T> rotate_weight(StdTensor<T> const& input) {
 	StdTensor<T> output({	input.shape()[1],
@@ -0,0 +1,232 @@
+#ifndef CONVOLUTION_MAXIMUMPOOL_HPP
+#define CONVOLUTION_MAXIMUMPOOL_HPP
+
+#ifdef LL_THREADS
+	#if LL_THREADS>1
+		#define USING_LL_THREADS
+	#endif
+#endif /* LL_THREADS */
+
+// General headers
+#include <cstdint>
+#ifdef USING_LL_THREADS
+#include <thread>
+#endif /* USING_LL_THREADS */
+#include <universal/posit/posit>
+#include <vector>
+
+// Custom headers
+#include "convolution.hpp"
+#include "maximumpool.hpp"
+#include "StdTensor.hpp"
+#include "Window.hpp"
+#include "../utils/Quire.hpp"
+#include "../utils/utils.hpp"
+
+// Namespaces
+using namespace sw::unum;
+
+// Offset of an output that was set to zero by the ReLU (its delta isn't propagated)
+// Like without maximum, also for size_t offsets (see no_maximum)
+uint8_t const RELU_ZERO = NO_MAXIMUM;
+
+// Convolution, maximum pooling and ReLU of some units (output channels of a sample, numbered through samples and channels)
+// Each output channel of the convolution is computed to a small buffer, which
+// is reduced by the pooling and ReLU, so only the pooled output is written
+// max_offset stores, for each output, the position of the maximum in its pooling window (if not NULL)
+template <size_t nbits, size_t es, typename Offset>
+void convolution2d_maximumpool2d_relu_thread(	StdTensor<posit<nbits, es>> const& input,
+												StdTensor<posit<nbits, es>> const& weight,
+												StdTensor<posit<nbits, es>> const& bias,
+												StdTensor<posit<nbits, es>>& output,
+												Window const* conv_w, Window const* pool_w,
+												Offset* max_offset,
+												size_t const unit_begin, size_t const unit_end	){
+
+	// Check if bias is empty
+	bool const no_bias = bias.empty();
+
+	// Get number of input and output channels
+	size_t const output_channels = weight.shape()[0];
+	size_t const input_channels = weight.shape()[1];
+
+	// Strides to loop tensors
+	size_t const input_batch_stride = input.strides()[0];
+	size_t const input_channel_stride = input.strides()[1];
+	size_t const output_channel_stride = output.strides()[1];
+	size_t const weight_out_channel_stride = weight.strides()[0];
+	size_t const weight_in_channel_stride = weight.strides()[1];
+
+	// Size of matrix after convolution and after pooling
+	size_t const conv_size = conv_w->output_height * conv_w->output_width;
+	size_t const size = output_channel_stride;
+
+	// Output of the convolution for one channel
+	std::vector<posit<nbits, es>> conv(conv_size);
+
+	// Initialize Quire
+	Quire<nbits, es> q;
+
+	// Indices of first unit (output channel of a sample)
+	size_t j = unit_begin % output_channels;
+	size_t input_batch = (unit_begin / output_channels) * input_batch_stride;
+	size_t weight_out_channel = j * weight_out_channel_stride;
+	size_t output_channel = unit_begin * output_channel_stride;
+
+	// Loop through units
+	for(size_t unit=unit_begin; unit<unit_end; unit++){
+
+		// Convolution: loop through its rows and cols
+		for(size_t idx=0; idx<conv_size; idx++){
+
+			// Indices of input and weight for input channel
+			size_t input_channel = input_batch;
+			size_t weight_in_channel = weight_out_channel;
+
+			// Set Quire to bias value
+			if(no_bias)
+				q.clear();
+			else
+				q = bias[j];
+
+			// Loop through input channels
+			for(size_t channel=0; channel<input_channels; channel++){
+				// Compute convolution for that block
+				do_convolution(	input, weight, q, *conv_w,
+								input_channel, weight_in_channel, idx	);
+
+				input_channel += input_channel_stride;
+				weight_in_channel += weight_in_channel_stride;
+			}
+
+			// Convert result from Quire to posit
+			convert(q.to_value(), conv[idx]);
+		}
+
+		// Maximum pooling and ReLU: loop through output rows and cols
+		for(size_t idx=0; idx<size; idx++){
+			size_t const output_idx = output_channel+idx;
+			size_t const begin = pool_w->window_idx[idx];
+			size_t const end = pool_w->window_idx[idx+1];
+
+			// First maximum (like std::max_element), comparing posits as integers
+			size_t max_i = begin;
+			int64_t max = (begin<end) ? posit_ordinal(conv[pool_w->map_window[begin]]) : 0;
+			for(size_t k=begin+1; k<end; k++){
+				int64_t const value = posit_ordinal(conv[pool_w->map_window[k]]);
+				if(max < value) {
+					max = value;
+					max_i = k;
+				}
+			}
+
+			// ReLU (max<=0 also for NaR, like ReLU)
+			if(begin==end || max <= 0){
+				output[output_idx].setzero();
+				if(max_offset != NULL)
+					max_offset[output_idx] = no_maximum<Offset>();	// RELU_ZERO
+			}
+			else {
+				output[output_idx] = conv[pool_w->map_window[max_i]];
+				if(max_offset != NULL)
+					max_offset[output_idx] = static_cast<Offset>(max_i - begin);
+			}
+		}
+
+		// Go to next output channel or sample
+		output_channel += output_channel_stride;
+		weight_out_channel += weight_out_channel_stride;
+
+		if(++j == output_channels) {
+			j = 0;
+			weight_out_channel = 0;
+			input_batch += input_batch_stride;
+		}
+	}
+}
+
+// Same as relu(maximumpool2d(convolution2d(input, ...))) without the intermediate tensors
+template <size_t nbits, size_t es, typename Offset>
+StdTensor<posit<nbits, es>> convolution2d_maximumpool2d_relu(	StdTensor<posit<nbits, es>> const& input,
+																StdTensor<posit<nbits, es>> const& weight,
+																StdTensor<posit<nbits, es>> const& bias,
+																size_t const stride,
+																size_t const padding,
+																size_t const dilation,
+																size_t const pool_kernel_size,
+																size_t const pool_stride,
+																size_t const pool_padding,
+																std::vector<Offset>* max_offset,
+																Window const* conv_w=NULL, Window const* pool_w=NULL,
+																StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>()	){
+
+	check_maxpool2d_offsets<Offset>(pool_kernel_size);
+
+	// Get windows (shared with other convolutions and poolings of the same geometry)
+	if(conv_w==NULL || !conv_w->initialized)
+		conv_w = &convolution2d_window(input.shape(), weight.shape(), stride, padding, 1, dilation);
+
+	if(pool_w==NULL || !pool_w->initialized)
+		pool_w = &pool2d_window(	{0, 0, conv_w->output_height, conv_w->output_width},
+									pool_kernel_size, pool_stride, pool_padding	);
+
+	// Get batch size and # of output channels
+	size_t const batch_size = input.shape()[0];
+	size_t const output_channels = weight.shape()[0];
+
+	// Not grouped
+	convolution2d_groups(input.shape()[1], weight.shape()[1], output_channels, 1);
+
+	// Create tensor for output (in the memory of storage, see StdTensor::reuse)
+	StdTensor<posit<nbits, es>> output = std::move(storage);
+	output.reuse({batch_size, output_channels, pool_w->output_height, pool_w->output_width});
+	Offset* offsets = NULL;
+	if(max_offset != NULL) {
+		max_offset->resize(output.size());
+		offsets = max_offset->data();
+	}
+
+#ifndef USING_LL_THREADS
+	convolution2d_maximumpool2d_relu_thread<nbits, es, Offset>(	input, weight, bias, output,
+																conv_w, pool_w, offsets,
+																0, batch_size*output_channels	);
+#else
+	// Distribute threads by samples and output channels (see convolution2d_partition)
+	// A pooled row needs several rows of the convolution, so output channels aren't split by rows
+	size_t const channel_work = conv_w->output_height * conv_w->output_width * weight.strides()[0];
+	std::vector<size_t> const begin = convolution2d_partition(	batch_size, output_channels, 1,
+																channel_work, LL_THREADS	);
+
+	const size_t max_threads = begin.size()-1;
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(convolution2d_maximumpool2d_relu_thread<nbits, es, Offset>,
+										std::cref(input), std::cref(weight), std::cref(bias), std::ref(output),
+										conv_w, pool_w, offsets,
+										begin[t], begin[t+1]	));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+
+	return output;
+}
+
+// Backward of the ReLU and maximum pooling
+// Returns the delta of the output of the convolution, with shape conv_shape
+template <size_t nbits, size_t es, typename Offset>
+StdTensor<posit<nbits, es>> maximumpool2d_relu_backward(	StdTensor<posit<nbits, es>> const& deltaN,
+															std::vector<size_t> const& conv_shape,
+															size_t const pool_kernel_size, size_t const pool_stride,
+															std::vector<Offset> const& max_offset,
+															Window const& pool_w	){
+
+	// Outputs zeroed by the ReLU are like windows without maximum
+	return maximumpool2d_backward(deltaN, conv_shape, pool_kernel_size, pool_stride, max_offset, pool_w);
+}
+
+#endif /* CONVOLUTION_MAXIMUMPOOL_HPP */
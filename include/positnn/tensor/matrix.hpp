@@ -17,10 +17,50 @@
 // Custom headers
 #include "StdTensor.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
+// Activation applied by matmul_row_add to each result before it is stored (see Linear)
+enum class Activation {none, relu, sigmoid, tanh};
+
+// Same results as the ReLU, Sigmoid and Tanh layers (with approximate=true)
+template <size_t nbits, size_t es>
+inline void activate(posit<nbits, es>& x, Activation const activation) {
+	switch(activation) {
+		case Activation::none:
+			break;
+
+		case Activation::relu:
+			if(x.isneg())
+				x.setzero();
+			break;
+
+		case Activation::sigmoid:
+			if(es==0) {
+				x = sigmoid_approx(x);
+			}
+			else {
+				x = 1/(1+exp(-x));
+				COUNT_POSIT_OPS(OP_EXP_LOG, 1);
+			}
+			break;
+
+		case Activation::tanh:
+			if(es==0) {
+				x = tanh_approx(x);
+			}
+			else {
+				posit<nbits, es> const plus = exp(x);
+				posit<nbits, es> const minus = exp(-x);
+				x = (plus-minus)/(plus+minus);
+				COUNT_POSIT_OPS(OP_EXP_LOG, 2);
+			}
+			break;
+	}
+}
+
 // Matrix transpose
 template <typename T>
 StdTensor<T> transpose(const StdTensor<T>& a, const size_t block=4){
@@ -91,6 +131,8 @@ void fused(	const StdTensor<posit<nbits, es>>& a,
 			result = fma(a[i], alpha, b[i]);
 			convert(result, c[i]);
 		}
+
+		COUNT_POSIT_OPS(OP_FUSED, a.size());
 	}
 }
 
@@ -386,7 +428,8 @@ void matmul_row_add_thread (const StdTensor<posit<nbits, es>>& a,
 							const size_t a_begin, size_t a_end,
 							const size_t b_begin, size_t b_end, const size_t b_size,
 							const size_t c_begin, const size_t c_size,
-							const size_t d_begin, const size_t stride){
+							const size_t d_begin, const size_t stride,
+							const Activation activation){
 
 	if(b_end == 0)			// to protect when b_end=0, which occurs when ncols=0
 		b_end = b_size;
@@ -414,16 +457,19 @@ void matmul_row_add_thread (const StdTensor<posit<nbits, es>>& a,
 
 			//std::cerr << "c_index=" << l << "/" << c.size() << " d_index=" << n << "/" << c.size() << std::endl;
 			q += c[l++];
-			convert(q.to_value(), d[n++]);
+			convert(q.to_value(), d[n]);
+			activate(d[n++], activation);
 		}
 	}
 
 	return;
 }
 
-// Matrix multiplication of rows and addition. Equivalent to D = A * B^T + C
+// Matrix multiplication of rows and addition. Equivalent to D = activation(A * B^T + C)
 template <size_t nbits, size_t es>
-StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a, const StdTensor<posit<nbits, es>>& b, const StdTensor<posit<nbits, es>>& c){
+StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a, const StdTensor<posit<nbits, es>>& b, const StdTensor<posit<nbits, es>>& c,
+											const Activation activation=Activation::none,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>()){
 	// TODO: THROW ERROR IF MATRIX DIMENSIONS ARE INVALID
 	const size_t rows = a.shape()[0];
 	const size_t cols = b.shape()[0];
@@ -431,7 +477,9 @@ StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a,
 	const size_t b_size = b.size();
 	const size_t c_size = c.size();
 
-	StdTensor<posit<nbits, es>> d({rows, cols});
+	// Output in the memory of storage (see StdTensor::reuse)
+	StdTensor<posit<nbits, es>> d = std::move(storage);
+	d.reuse({rows, cols});
 	const size_t size = d.size();
 
 	const size_t max_threads = (LL_THREADS<size) ? LL_THREADS : size;
@@ -478,7 +526,7 @@ StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a,
 										a_begin*stride, a_end*stride,
 										b_begin*stride, b_end*stride, b_size,
 										c_begin, c_size,
-										d_begin, stride));
+										d_begin, stride, activation));
 
 		//getchar();
 	}
@@ -492,11 +540,15 @@ StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a,
 
 #else
 
-// Matrix multiplication of rows and addition. Equivalent to D = A * B^T + C
+// Matrix multiplication of rows and addition. Equivalent to D = activation(A * B^T + C)
 template <size_t nbits, size_t es>
-StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a, const StdTensor<posit<nbits, es>>& b, const StdTensor<posit<nbits, es>>& c){
+StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a, const StdTensor<posit<nbits, es>>& b, const StdTensor<posit<nbits, es>>& c,
+											const Activation activation=Activation::none,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>()){
 	// TODO: THROW ERROR IF MATRIX DIMENSIONS ARE INVALID
-	StdTensor<posit<nbits, es>> d({a.shape()[0], b.shape()[0]});
+	// Output in the memory of storage (see StdTensor::reuse)
+	StdTensor<posit<nbits, es>> d = std::move(storage);
+	d.reuse({a.shape()[0], b.shape()[0]});
 
 	Quire<nbits, es> q;	// TODO: COMPUTE BEST CAPACITY
 
@@ -514,7 +566,8 @@ StdTensor<posit<nbits, es>> matmul_row_add(const StdTensor<posit<nbits, es>>& a,
 				q += Quire_mul(a[i+k], b[j+k]);
 			}
 			q += c[n%c_size];
-			convert(q.to_value(), d[n++]);
+			convert(q.to_value(), d[n]);
+			activate(d[n++], activation);
 		}
 	}
 
@@ -8,6 +8,10 @@
 #endif /* LL_THREADS */
 
 // General headers
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
 #ifdef USING_LL_THREADS
 #include <thread>
 #endif /* USING_LL_THREADS */
@@ -18,14 +22,40 @@
 #include "StdTensor.hpp"
 #include "Window.hpp"
 #include "../utils/Quire.hpp"
+#include "../utils/parallel.hpp"
+#include "../utils/utils.hpp"
 
 // Namespaces
 using namespace sw::unum;
 
-template <size_t nbits, size_t es>
+// For backward, the maximum of each output is stored as its offset in the window
+// (1 byte instead of the index in the input)
+// Offset of an output whose window has no input (its delta isn't propagated)
+uint8_t const NO_MAXIMUM = 0xFF;
+
+// Windows with NO_MAXIMUM or more elements (kernel_size >= 16) store their offsets in size_t instead
+// The largest value of the type of the offsets is always the one without maximum
+template <typename Offset>
+constexpr Offset no_maximum() {
+	return std::numeric_limits<Offset>::max();
+}
+
+// If the offsets of the maximums of a pooling fit in 1 byte
+inline bool maxpool2d_byte_offsets(size_t const kernel_size) {
+	return kernel_size*kernel_size < NO_MAXIMUM;
+}
+
+// Offsets of the maximums must fit in Offset (and be different from no_maximum)
+template <typename Offset>
+void check_maxpool2d_offsets(size_t const kernel_size) {
+	if(kernel_size*kernel_size >= no_maximum<Offset>())
+		throw std::invalid_argument( "pooling window is too large to store its offsets in 8 bits (use size_t offsets)" );
+}
+
+template <size_t nbits, size_t es, typename Offset>
 void do_maxpool2d(	StdTensor<posit<nbits, es>> const& input,
 					posit<nbits, es>& output,
-					Window const& w, size_t* max_idx,
+					Window const& w, Offset* max_offset,
 					size_t const input_idx, size_t const idx	){
 	
 	// Begin and end element to operate
@@ -33,47 +63,44 @@ void do_maxpool2d(	StdTensor<posit<nbits, es>> const& input,
 	size_t const end = w.window_idx[idx+1];
 
 	// If there is no overlap between input and kernel
-	if(begin == end)
+	if(begin == end) {
+		output.setzero();
+		if(max_offset != NULL)
+			*max_offset = no_maximum<Offset>();
 		return;
+	}
 
-	size_t input_i = input_idx;
+	// Loop through elements to operate with input and kernel
+	// First maximum (like std::max_element), comparing posits as integers
+	size_t max_k = begin;
+	int64_t max = posit_ordinal(input[input_idx+w.map_window[begin]]);
 
-	// Element only appears in 1 window
-	if(begin+1 == end){
-		input_i += w.map_window[begin];
-	}
-	// More than 1 element
-	else{
-		// Loop through elements to operate with input and kernel
-		size_t max_i = *std::max_element(
-							w.map_window.begin()+begin,
-							w.map_window.begin()+end,
-							[&](size_t a, size_t b){
-								return input[input_idx+a] < input[input_idx+b];
-						   	}
-						);
-
-		input_i += max_i;
+	for(size_t k=begin+1; k<end; k++){
+		int64_t const value = posit_ordinal(input[input_idx+w.map_window[k]]);
+		if(max < value) {
+			max = value;
+			max_k = k;
+		}
 	}
 
-	output = input[input_i];
+	output = input[input_idx+w.map_window[max_k]];
 
-	if(max_idx != NULL)
-		*max_idx = input_i;
+	if(max_offset != NULL)
+		*max_offset = static_cast<Offset>(max_k - begin);
 
 	return;
 }
 
 #ifdef USING_LL_THREADS
 
-template <size_t nbits, size_t es>
+template <size_t nbits, size_t es, typename Offset>
 void maximumpool2d_thread(	StdTensor<posit<nbits, es>> const& input,
 							StdTensor<posit<nbits, es>>& output,
-							Window const* w, std::vector<size_t>* max_idx,
+							Window const* w, std::vector<Offset>* max_offset,
 							size_t input_batch, size_t output_batch,
 							size_t const n_samples	){
 
-	bool const empty_max = (max_idx==NULL);
+	bool const empty_max = (max_offset==NULL);
 
 	// Get number of output channels
 	size_t const input_channels = input.shape()[1];
@@ -97,7 +124,7 @@ void maximumpool2d_thread(	StdTensor<posit<nbits, es>> const& input,
 			// Loop through output rows and cols
 			for(size_t idx=0; idx<size; idx++){
 				size_t output_idx = output_channel+idx;
-				size_t* max_i = (empty_max) ? NULL : &((*max_idx)[output_idx]);
+				Offset* max_i = (empty_max) ? NULL : &((*max_offset)[output_idx]);
 
 				// Compute maximum pooling for that block
 				do_maxpool2d<nbits, es>(	input, output[output_idx],
@@ -114,39 +141,34 @@ void maximumpool2d_thread(	StdTensor<posit<nbits, es>> const& input,
 	}
 }
 
-template <size_t nbits, size_t es>
+template <size_t nbits, size_t es, typename Offset=uint8_t>
 StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& input,
 											size_t const kernel_size,
 											size_t const stride,
 											size_t const padding,
-											std::vector<size_t>* max_idx=NULL,
-											Window* w=NULL){
+											std::vector<Offset>* max_offset=NULL,
+											Window const* w=NULL,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>()){
 	//
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
+	check_maxpool2d_offsets<Offset>(kernel_size);
 	
-	// Get windows
-	bool empty = (w==NULL);
-
-	if(empty)
-		w = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							kernel_size, kernel_size,
-							stride, padding	);
-	}
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(input.shape(), kernel_size, stride, padding);
 
 	// Get batch size and # of input channels
 	size_t const batch_size = input.shape()[0];
 	size_t const input_channels = input.shape()[1];
 
-	// Create tensor for output
-	StdTensor<posit<nbits, es>> output({batch_size, input_channels, w->output_height, w->output_width});
+	// Create tensor for output (in the memory of storage, see StdTensor::reuse)
+	StdTensor<posit<nbits, es>> output = std::move(storage);
+	output.reuse({batch_size, input_channels, w->output_height, w->output_width});
 
-	bool const empty_max = (max_idx==NULL);
+	bool const empty_max = (max_offset==NULL);
 	if(!empty_max)
-		max_idx->resize(output.size());
+		max_offset->resize(output.size());
 
 	// Strides to loop tensors
 	size_t const input_batch_stride = input.strides()[0];
@@ -176,9 +198,9 @@ StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& in
 		if(t < nthreads_more)
 			thread_samples++;
 
-		threads.push_back(std::thread(maximumpool2d_thread<nbits, es>,
+		threads.push_back(std::thread(maximumpool2d_thread<nbits, es, Offset>,
 										std::cref(input), std::ref(output),
-										w, max_idx,
+										w, max_offset,
 										input_samples_begin, output_samples_begin,
 										thread_samples	));
 		
@@ -196,45 +218,38 @@ StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& in
 		t.join();
 	}	
 
-	if(empty)
-		delete w;
-
 	return output;
 }
 
 
 #else
 
-template <size_t nbits, size_t es>
+template <size_t nbits, size_t es, typename Offset=uint8_t>
 StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& input,
 											size_t const kernel_size,
 											size_t const stride,
 											size_t const padding,
-											std::vector<size_t>* max_idx=NULL,
-											Window* w=NULL){
+											std::vector<Offset>* max_offset=NULL,
+											Window const* w=NULL,
+											StdTensor<posit<nbits, es>> storage=StdTensor<posit<nbits, es>>()){
 
 	// TODO: throw error if kernel and input have different in_channels
 	// TODO: check other errors
+	check_maxpool2d_offsets<Offset>(kernel_size);
 
-	bool const empty = (w==NULL);
-
-	if(empty)
-		w  = new Window();
-
-	if(!w->initialized){
-		w->output_to_input(	input.shape()[2], input.shape()[3],
-							kernel_size, kernel_size,
-							stride, padding	);
-	}
+	// Get windows (shared with other poolings of the same geometry)
+	if(w==NULL || !w->initialized)
+		w = &pool2d_window(input.shape(), kernel_size, stride, padding);
 
 	size_t const batch_size = input.shape()[0];
 	size_t const input_channels = input.shape()[1];
 
-	StdTensor<posit<nbits, es>> output({batch_size, input_channels, w->output_height, w->output_width});
+	StdTensor<posit<nbits, es>> output = std::move(storage);
+	output.reuse({batch_size, input_channels, w->output_height, w->output_width});
 
-	bool const empty_max = (max_idx==NULL);
+	bool const empty_max = (max_offset==NULL);
 	if(!empty_max)
-		max_idx->resize(output.size());
+		max_offset->resize(output.size());
 
 	size_t const input_batch_stride = input.strides()[0];
 	size_t const input_channel_stride = input.strides()[1];
@@ -257,7 +272,7 @@ StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& in
 			// Loop through output rows and cols
 			for(size_t idx=0; idx<size; idx++){
 				size_t output_idx = output_channel+idx;
-				size_t* max_i = (empty_max) ? NULL : &((*max_idx)[output_idx]);
+				Offset* max_i = (empty_max) ? NULL : &((*max_offset)[output_idx]);
 
 				// Compute maximum pooling for that block
 				do_maxpool2d<nbits, es>(	input, output[output_idx],
@@ -273,9 +288,6 @@ StdTensor<posit<nbits, es>> maximumpool2d(	StdTensor<posit<nbits, es>> const& in
 		output_batch += output_batch_stride;
 	}
 
-	if(empty)
-		delete w;
-
 	return output;
 }
 
@@ -477,4 +489,95 @@ StdTensor<posit<nbits, es>> maximumpool2d_backward(	StdTensor<posit<nbits, es>>
 
 #endif /* USING_LL_THREADS */
 
+// Entry of the input channel that was the maximum of the window of output idx (or none)
+template <typename Offset>
+size_t maxpool2d_maximum(	std::vector<Offset> const& max_offset, Window const& w,
+							size_t const output_channel, size_t const idx, size_t const none	){
+
+	Offset const offset = max_offset[output_channel + idx];
+	return (offset == no_maximum<Offset>()) ? none : w.map_window[w.window_idx[idx] + offset];
+}
+
+// Backward of the channels [channel_begin, channel_end) from the offsets of the maximums in their windows
+// Windows that overlap (stride < kernel_size) are at most reach outputs apart, so the deltas of the
+// outputs with the same maximum are summed in a quire by the first of them, in order of the outputs
+template <size_t nbits, size_t es, typename Offset>
+void maximumpool2d_backward_thread(	StdTensor<posit<nbits, es>> const& deltaN,
+									StdTensor<posit<nbits, es>>& deltaN_1,
+									std::vector<Offset> const& max_offset,
+									Window const& w, size_t const reach,
+									size_t const channel_begin, size_t const channel_end	){
+
+	size_t const output_size = deltaN.strides()[1];
+	size_t const input_size = deltaN_1.strides()[1];
+	size_t const output_height = w.output_height;
+	size_t const output_width = w.output_width;
+
+	Quire<nbits, es> q;
+
+	for(size_t c=channel_begin; c<channel_end; c++) {
+		size_t const output_channel = c*output_size;
+		size_t const input_channel = c*input_size;
+
+		for(size_t oh=0, idx=0; oh<output_height; oh++) {
+			size_t const row_begin = (oh>reach) ? oh-reach : 0;
+			size_t const row_end = (oh+reach+1 < output_height) ? oh+reach+1 : output_height;
+
+			for(size_t ow=0; ow<output_width; ow++, idx++) {
+				size_t const maximum = maxpool2d_maximum(max_offset, w, output_channel, idx, input_size);
+				if(maximum == input_size)
+					continue;
+
+				// Windows don't overlap, so each delta goes to a different entry
+				if(reach == 0) {
+					deltaN_1[input_channel + maximum] = deltaN[output_channel + idx];
+					continue;
+				}
+
+				size_t const col_begin = (ow>reach) ? ow-reach : 0;
+				size_t const col_end = (ow+reach+1 < output_width) ? ow+reach+1 : output_width;
+				bool first = true;
+				q.clear();
+
+				for(size_t h=row_begin; h<row_end && first; h++) {
+					for(size_t x=col_begin; x<col_end; x++) {
+						size_t const other = h*output_width + x;
+						if(maxpool2d_maximum(max_offset, w, output_channel, other, input_size) != maximum)
+							continue;
+
+						// Already summed by a previous output
+						if(other < idx) {
+							first = false;
+							break;
+						}
+
+						q += deltaN[output_channel + other];
+					}
+				}
+
+				if(first)
+					convert(q.to_value(), deltaN_1[input_channel + maximum]);
+			}
+		}
+	}
+}
+
+// Backward from the offsets of the maximums in their windows (see do_maxpool2d)
+// Threads take different channels, so they never write to the same entries
+template <size_t nbits, size_t es, typename Offset>
+StdTensor<posit<nbits, es>> maximumpool2d_backward(	StdTensor<posit<nbits, es>> const& deltaN,
+													std::vector<size_t> const& input_shape,
+													size_t const kernel_size, size_t const stride,
+													std::vector<Offset> const& max_offset,
+													Window const& w	){
+
+	StdTensor<posit<nbits, es>> deltaN_1(input_shape);
+	size_t const reach = (kernel_size>0) ? (kernel_size-1)/stride : 0;
+
+	parallel_units(	input_shape[0]*input_shape[1], maximumpool2d_backward_thread<nbits, es, Offset>,
+					std::cref(deltaN), std::ref(deltaN_1), std::cref(max_offset), std::cref(w), reach	);
+
+	return deltaN_1;
+}
+
 #endif /* MAXIMUMPOOL_HPP */
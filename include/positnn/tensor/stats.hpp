@@ -2,10 +2,13 @@
 #define STATS_HPP
 
 // General headers
+#include <functional>
 #include <universal/posit/posit>
+#include <vector>
 
 // Custom headers
 #include "StdTensor.hpp"
+#include "../utils/parallel.hpp"
 #include "../utils/Quire.hpp"
 
 // Namespaces
@@ -30,27 +33,177 @@ T calculate_mean(StdTensor<T> const& x) {
 	return mean;
 }
 
-// Variance of tensor
-template <typename T> 
-T calculate_var(StdTensor<T> const& x, size_t ddof=0) {
-	// Calculate mean
-	T mean = calculate_mean(x);
+// Statistics per channel of a tensor seen as {outer, channels, inner}, e.g.
+// {N, C, H*W} with channels first, {N*H*W, C, 1} with channels last and {N, F, 1} for features
+// Sums of a and of a*b for channels [channel_begin, channel_end), in a single pass through the tensors
+// Either the inner axis (channels first) or the channels (otherwise) are read contiguously
+template <size_t nbits, size_t es>
+void channel_sums_thread(	StdTensor<posit<nbits, es>> const& a,
+							StdTensor<posit<nbits, es>> const& b,
+							std::vector<Quire<nbits, es>>& sum,
+							std::vector<Quire<nbits, es>>& sum_product,
+							size_t const inner,
+							size_t const channel_begin, size_t const channel_end	){
+
+	size_t const channels = sum.size();
+	size_t const block = channels * inner;
+	size_t const size = a.size();
+
+	for(size_t c=channel_begin; c<channel_end; c++){
+		sum[c].clear();
+		sum_product[c].clear();
+	}
+
+	// Loop through outer axis
+	for(size_t outer=0; outer<size; outer+=block){
+
+		// Loop through channels and inner axis
+		for(size_t c=channel_begin; c<channel_end; c++){
+			for(size_t i=outer+c*inner, i_end=i+inner; i<i_end; i++){
+				sum[c] += a[i];
+				sum_product[c] += Quire_mul(a[i], b[i]);
+			}
+		}
+	}
+}
+
+// Sums of a and of a*b of each channel, accumulated in quires (see channel_sums_thread)
+template <size_t nbits, size_t es>
+void channel_sums(	StdTensor<posit<nbits, es>> const& a,
+					StdTensor<posit<nbits, es>> const& b,
+					size_t const channels, size_t const inner,
+					std::vector<Quire<nbits, es>>& sum,
+					std::vector<Quire<nbits, es>>& sum_product	){
+
+	sum.resize(channels);
+	sum_product.resize(channels);
 
+	parallel_units(channels, channel_sums_thread<nbits, es>,
+					std::cref(a), std::cref(b), std::ref(sum), std::ref(sum_product), inner);
+}
+
+// Sums of x for channels [channel_begin, channel_end)
+template <size_t nbits, size_t es>
+void channel_sum_thread(	StdTensor<posit<nbits, es>> const& x,
+							std::vector<Quire<nbits, es>>& sum,
+							size_t const inner,
+							size_t const channel_begin, size_t const channel_end	){
+
+	size_t const channels = sum.size();
+	size_t const block = channels * inner;
 	size_t const size = x.size();
-	Quire<T::nbits, T::es> sum;
-	sum.clear();
-	T var;
 
-	// Calculate variance
-	for(size_t i=0; i<size; i++){
-		T delta = mean - x[i];
-		sum += Quire_mul(delta, delta);
+	for(size_t c=channel_begin; c<channel_end; c++)
+		sum[c].clear();
+
+	// Loop through outer axis
+	for(size_t outer=0; outer<size; outer+=block){
+
+		// Loop through channels and inner axis
+		for(size_t c=channel_begin; c<channel_end; c++){
+			for(size_t i=outer+c*inner, i_end=i+inner; i<i_end; i++)
+				sum[c] += x[i];
+		}
+	}
+}
+
+// Sums of x-shift and of (x-shift)^2 for channels [channel_begin, channel_end), in a single pass
+// The shift of each channel should be close to its mean, so the sums don't grow with the mean
+template <size_t nbits, size_t es>
+void channel_shifted_sums_thread(	StdTensor<posit<nbits, es>> const& x,
+									std::vector<posit<nbits, es>> const& shift,
+									std::vector<Quire<nbits, es>>& sum,
+									std::vector<Quire<nbits, es>>& sum_squares,
+									size_t const inner,
+									size_t const channel_begin, size_t const channel_end	){
+
+	size_t const channels = sum.size();
+	size_t const block = channels * inner;
+	size_t const size = x.size();
+
+	for(size_t c=channel_begin; c<channel_end; c++){
+		sum[c].clear();
+		sum_squares[c].clear();
+	}
+
+	// Loop through outer axis
+	for(size_t outer=0; outer<size; outer+=block){
+
+		// Loop through channels and inner axis
+		for(size_t c=channel_begin; c<channel_end; c++){
+			for(size_t i=outer+c*inner, i_end=i+inner; i<i_end; i++){
+				posit<nbits, es> const centered = x[i] - shift[c];
+				sum[c] += centered;
+				sum_squares[c] += Quire_mul(centered, centered);
+			}
+		}
 	}
+}
+
+// Mean and variance of each channel (see channel_shifted_sums_thread)
+// With quires, the sums are only rounded at the end, so a single pass through x is enough: with
+// d = x-shift and the shift being the first value of each channel,
+// mean = shift + sum(d)/n and variance = (sum(d^2) - sum(d)*sum(d)/n) / (n-ddof)
+// Without quires (QUIRE_MODE=0), every accumulation is rounded and that difference would cancel
+// badly, so the mean is computed in a first pass and variance = sum((x-mean)^2) / (n-ddof)
+template <size_t nbits, size_t es>
+void channel_mean_variance(	StdTensor<posit<nbits, es>> const& x,
+							size_t const channels, size_t const inner,
+							StdTensor<posit<nbits, es>>& mean,
+							StdTensor<posit<nbits, es>>& variance,
+							size_t const ddof=0	){
+
+	size_t const count = (channels>0) ? x.size() / channels : 0;
+	if(count==0)
+		return;
+
+	std::vector<posit<nbits, es>> shift(channels);
+	std::vector<Quire<nbits, es>> sum(channels), sum_squares(channels);
+
+#if defined(QUIRE_MODE) && QUIRE_MODE>0
+	for(size_t c=0; c<channels; c++)
+		shift[c] = x[c*inner];
+#else
+	parallel_units(channels, channel_sum_thread<nbits, es>, std::cref(x), std::ref(sum), inner);
 
-	convert(sum.to_value(), var);
-	var /= (size-ddof);
+	for(size_t c=0; c<channels; c++){
+		convert(sum[c].to_value(), shift[c]);
+		shift[c] /= count;
+	}
+#endif /* QUIRE_MODE */
+
+	parallel_units(channels, channel_shifted_sums_thread<nbits, es>,
+					std::cref(x), std::cref(shift), std::ref(sum), std::ref(sum_squares), inner);
+
+	posit<nbits, es> channel_sum, mean_shifted;
+
+	for(size_t c=0; c<channels; c++){
+#if defined(QUIRE_MODE) && QUIRE_MODE>0
+		convert(sum[c].to_value(), channel_sum);
+		mean_shifted = channel_sum / count;
+		mean[c] = shift[c] + mean_shifted;
+
+		sum_squares[c] -= Quire_mul(mean_shifted, channel_sum);
+#else
+		mean[c] = shift[c];
+#endif /* QUIRE_MODE */
+		convert(sum_squares[c].to_value(), variance[c]);
+		variance[c] /= (count>ddof) ? count-ddof : 1;
+
+		// Rounding of the mean may give a tiny negative variance
+		if(variance[c].isneg() && !variance[c].isnar())
+			variance[c].setzero();
+	}
+}
+
+// Variance of tensor (see channel_mean_variance)
+template <typename T> 
+T calculate_var(StdTensor<T> const& x, size_t ddof=0) {
+	StdTensor<T> mean(1);
+	StdTensor<T> var(1);
+	channel_mean_variance(x, 1, x.size(), mean, var, ddof);
 
-	return var;
+	return var[0];
 }
 
 // Standard deviation of tensor
@@ -0,0 +1,196 @@
+#ifndef CHECKPOINTER_HPP
+#define CHECKPOINTER_HPP
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define USING_FSYNC
+#endif
+
+// General headers
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef USING_FSYNC
+#include <unistd.h>
+#endif /* USING_FSYNC */
+
+// Custom headers
+#include "save_load.hpp"
+#include "../layer/Parameter.hpp"
+#include "../tensor/StdTensor.hpp"
+
+// Saves models in a background thread (files are the same as save())
+// The parameters are copied when save() is called, so training can continue
+// and change them while they are encoded and written by the thread
+class Checkpointer {
+public:
+	Checkpointer(size_t const _max_pending=2, bool const _sync=false) :
+		max_pending(_max_pending>0 ? _max_pending : 1),
+		sync(_sync),
+		worker(&Checkpointer::run, this)
+	{ }
+
+	// Write pending checkpoints before returning
+	~Checkpointer() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		not_empty.notify_one();
+		worker.join();
+	}
+
+	Checkpointer(Checkpointer const&) = delete;
+	Checkpointer& operator=(Checkpointer const&) = delete;
+
+	// Snapshot parameters and queue them to be written
+	// Blocks if there are already max_pending checkpoints waiting
+	// Future gets 0 if file was written, -1 otherwise
+	template <typename PositFile, typename T>
+	std::future<int> save(T& object, std::string const& filename) {
+		Job job;
+		job.filename = filename;
+		job.snapshot = snapshot<PositFile>(object.parameters(), object.buffers());
+		std::future<int> result = job.promise.get_future();
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			not_full.wait(lock, [this]{ return queue.size() < max_pending; });
+			queue.push_back(std::move(job));
+		}
+		not_empty.notify_one();
+
+		return result;
+	}
+
+	// Wait until every queued checkpoint is written
+	void wait() {
+		std::unique_lock<std::mutex> lock(mutex);
+		idle.wait(lock, [this]{ return queue.empty() && !busy; });
+	}
+
+private:
+	// Tensors of a model, written by the thread as Layer::write does
+	struct Snapshot {
+		virtual ~Snapshot() { }
+		virtual void write(std::ostream& out) = 0;
+	};
+
+	template <typename PositFile, typename Posit>
+	struct TensorSnapshot : Snapshot {
+		void write(std::ostream& out) override {
+			write_header<PositFile>(out);
+			for(StdTensor<Posit>& tensor : tensors)
+				tensor.template write<PositFile>(out);
+		}
+
+		std::vector<StdTensor<Posit>> tensors;
+	};
+
+	struct Job {
+		std::string filename;
+		std::unique_ptr<Snapshot> snapshot;
+		std::promise<int> promise;
+	};
+
+	// Only copies the parameters and buffers (in the order they are saved), without encoding them
+	template <typename PositFile, typename Posit>
+	static std::unique_ptr<Snapshot> snapshot(	std::vector<Parameter<Posit>> const& parameters,
+												std::vector<Buffer<Posit>> const& buffers	){
+
+		std::unique_ptr<TensorSnapshot<PositFile, Posit>> s(new TensorSnapshot<PositFile, Posit>());
+		s->tensors.reserve(parameters.size() + buffers.size());
+
+		for(Parameter<Posit> const& p : parameters)
+			s->tensors.push_back(p.weight);
+
+		for(Buffer<Posit> const& b : buffers)
+			s->tensors.push_back(b.tensor);
+
+		return s;
+	}
+
+	void run() {
+		while(true) {
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				not_empty.wait(lock, [this]{ return stop || !queue.empty(); });
+
+				// Only stop after the queue is empty
+				if(queue.empty())
+					return;
+
+				job = std::move(queue.front());
+				queue.pop_front();
+				busy = true;
+			}
+			not_full.notify_one();
+
+			std::ostringstream out(std::ios::out | std::ios::binary);
+			job.snapshot->write(out);
+			job.snapshot.reset();
+
+			int const status = write_file(job.filename, out.str());
+			if(status == 0)
+				std::cout << "Saved to: " << job.filename << std::endl;
+			job.promise.set_value(status);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				busy = false;
+			}
+			idle.notify_all();
+		}
+	}
+
+	// Write to a temporary file and rename it, so that an interrupted write
+	// never leaves a partial checkpoint with the final name
+	int write_file(std::string const& filename, std::string const& data) const {
+		std::string const temporary = filename + ".tmp";
+		std::FILE* file = std::fopen(temporary.c_str(), "wb");
+
+		if(file == NULL) {
+			std::cout << "Error in creating file: " << filename << std::endl;
+			return -1;
+		}
+
+		bool ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+		ok = std::fflush(file)==0 && ok;
+#ifdef USING_FSYNC
+		if(sync)
+			ok = fsync(fileno(file))==0 && ok;
+#endif /* USING_FSYNC */
+		ok = std::fclose(file)==0 && ok;
+
+		if(!ok || std::rename(temporary.c_str(), filename.c_str())!=0) {
+			std::cout << "Error in writing file: " << filename << std::endl;
+			std::remove(temporary.c_str());
+			return -1;
+		}
+
+		return 0;
+	}
+
+	size_t const max_pending;
+	bool const sync;	// flush file to disk (fsync) before renaming it
+	bool stop = false;
+	bool busy = false;
+	std::deque<Job> queue;
+	std::mutex mutex;
+	std::condition_variable not_empty;
+	std::condition_variable not_full;
+	std::condition_variable idle;
+	std::thread worker;	// last member, so it starts after the others are constructed
+};
+
+#endif /* CHECKPOINTER_HPP */
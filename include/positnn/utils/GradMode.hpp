@@ -0,0 +1,70 @@
+#ifndef GRADMODE_HPP
+#define GRADMODE_HPP
+
+// If disabled, forward of layers doesn't keep what backward needs (inputs, outputs, masks, ...)
+// It is per thread, so guards on different threads don't interfere. Threads that run layers
+// (e.g. the HL_THREADS workers of train_test_threads) get it from their caller with an AutoGradMode
+// The LL_THREADS workers of the kernels don't need it, since layers check it before starting them
+class GradMode {
+public:
+	static bool is_enabled() {
+		return enabled();
+	}
+
+	static void set_enabled(bool const enable) {
+		enabled() = enable;
+	}
+
+private:
+	static bool& enabled() {
+		static thread_local bool e = true;
+		return e;
+	}
+};
+
+// Sets GradMode of this thread while it exists (e.g. to the one of the thread that started it)
+class AutoGradMode {
+public:
+	explicit AutoGradMode(bool const enabled) :
+		previous(GradMode::is_enabled())
+	{
+		GradMode::set_enabled(enabled);
+	}
+
+	~AutoGradMode() {
+		GradMode::set_enabled(previous);
+	}
+
+	AutoGradMode(AutoGradMode const&) = delete;
+	AutoGradMode& operator=(AutoGradMode const&) = delete;
+
+private:
+	bool const previous;
+};
+
+// Disables GradMode while it exists (e.g. in test or inference)
+class NoGradGuard : public AutoGradMode {
+public:
+	NoGradGuard() :
+		AutoGradMode(false)
+	{ }
+};
+
+// Modules without parameters that keep state for backward (e.g. ReLU, MaxPool2d)
+// Once registered in a model (see Layer::register_module), its eval() also applies to them
+class BackwardState {
+public:
+	void set_inference(bool const _inference) {
+		inference = _inference;
+	}
+
+	// If forward has to keep what backward needs (not after eval() of the model or with a NoGradGuard)
+	bool save_for_backward() const {
+		return !inference && GradMode::is_enabled();
+	}
+
+protected:
+	bool inference = false;
+};
+
+#endif /* GRADMODE_HPP */
@@ -0,0 +1,135 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#if defined(__unix__) || defined(__APPLE__)
+	#define USING_MMAP
+#endif
+
+// General headers
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef USING_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif /* USING_MMAP */
+
+// Read-only file mapped to memory (read to a buffer if mmap is not available)
+class MappedFile {
+public:
+	MappedFile() { }
+
+	~MappedFile() {
+		close();
+	}
+
+	MappedFile(MappedFile const&) = delete;
+	MappedFile& operator=(MappedFile const&) = delete;
+
+	// Sequential files are read ahead more aggressively
+	int open(std::string const& filename, bool const sequential=false) {
+		close();
+
+#ifdef USING_MMAP
+		int const fd = ::open(filename.c_str(), O_RDONLY);
+
+		if(fd < 0) {
+			std::cout << "Error in opening file: " << filename << std::endl;
+			return -1;
+		}
+
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size == 0) {
+			std::cout << "Error in opening file: " << filename << std::endl;
+			::close(fd);
+			return -1;
+		}
+
+		void* address = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+
+		if(address == MAP_FAILED) {
+			std::cout << "Error in mapping file: " << filename << std::endl;
+			return -1;
+		}
+
+		if(sequential)
+			madvise(address, st.st_size, MADV_SEQUENTIAL);
+
+		m_data = static_cast<char const*>(address);
+		m_size = st.st_size;
+#else
+		(void) sequential;
+
+		std::ifstream file(filename, std::ios::in | std::ios::binary | std::ios::ate);
+
+		if(!file) {
+			std::cout << "Error in opening file: " << filename << std::endl;
+			return -1;
+		}
+
+		m_buffer.resize(file.tellg());
+		file.seekg(0);
+		file.read(m_buffer.data(), m_buffer.size());
+
+		m_data = m_buffer.data();
+		m_size = m_buffer.size();
+#endif /* USING_MMAP */
+
+		return 0;
+	}
+
+	void close() {
+#ifdef USING_MMAP
+		if(m_data != nullptr)
+			munmap(const_cast<char*>(m_data), m_size);
+#else
+		m_buffer.clear();
+		m_buffer.shrink_to_fit();
+#endif /* USING_MMAP */
+
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	// Tell the system that [begin, end) is no longer needed, so that files
+	// larger than the memory can be streamed (pages are read again if used)
+	void release(size_t const begin, size_t const end) const {
+#ifdef USING_MMAP
+		size_t const page = sysconf(_SC_PAGESIZE);
+		size_t const first = (begin + page-1) / page * page;
+		size_t const last = (end < m_size) ? end / page * page : m_size;
+
+		if(m_data != nullptr && first < last)
+			madvise(const_cast<char*>(m_data) + first, last-first, MADV_DONTNEED);
+#else
+		(void) begin;
+		(void) end;
+#endif /* USING_MMAP */
+	}
+
+	bool is_open() const {
+		return m_data != nullptr;
+	}
+
+	char const* data() const {
+		return m_data;
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+private:
+	char const* m_data = nullptr;
+	size_t m_size = 0;
+#ifndef USING_MMAP
+	std::vector<char> m_buffer;
+#endif /* USING_MMAP */
+};
+
+#endif /* MAPPEDFILE_HPP */
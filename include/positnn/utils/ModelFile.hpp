@@ -0,0 +1,321 @@
+#ifndef MODELFILE_HPP
+#define MODELFILE_HPP
+
+// General headers
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Custom headers
+#include "../layer/Parameter.hpp"
+#include "../tensor/StdTensor.hpp"
+#include "MappedFile.hpp"
+#include "utils.hpp"
+
+// Model file with an index of tensors, which can be mapped to memory
+// Layout (every word is a size_t):
+//	header:	magic, version, # of tensors, index offset, data offset, alignment
+//	index:	for each tensor: name length, name, nbits, es, dim, shape, offset, # of bytes
+//	data:	raw posit bits of each tensor (see encode_posits), aligned to alignment bytes
+constexpr size_t MODEL_FILE_MAGIC = 0x4c45444f4d4e4e50;	// "PNNMODEL"
+constexpr size_t MODEL_FILE_VERSION = 3;
+constexpr size_t MODEL_FILE_ALIGNMENT = 64;
+
+struct TensorEntry {
+	std::string name;
+	size_t nbits;
+	size_t es;
+	std::vector<size_t> shape;
+	size_t offset;	// in bytes, from the beginning of the file
+	size_t nbytes;
+};
+
+class ModelFile {
+public:
+	ModelFile() { }
+
+	ModelFile(std::string const& filename) {
+		open(filename);
+	}
+
+	~ModelFile() {
+		close();
+	}
+
+	ModelFile(ModelFile const&) = delete;
+	ModelFile& operator=(ModelFile const&) = delete;
+
+	// Map file to memory and read its index
+	int open(std::string const& filename) {
+		close();
+
+		if(m_file.open(filename) != 0)
+			return -1;
+
+		m_data = reinterpret_cast<unsigned char const*>(m_file.data());
+		m_size = m_file.size();
+
+		if(read_index() != 0) {
+			std::cerr << "ERROR: invalid model file: " << filename << std::endl;
+			close();
+			return -1;
+		}
+
+		return 0;
+	}
+
+	void close() {
+		m_file.close();
+		m_data = nullptr;
+		m_size = 0;
+		m_tensors.clear();
+		m_names.clear();
+	}
+
+	bool is_open() const {
+		return m_data != nullptr;
+	}
+
+	std::vector<TensorEntry> const& tensors() const {
+		return m_tensors;
+	}
+
+	// Get entry of tensor with that name (NULL if it doesn't exist)
+	TensorEntry const* find(std::string const& name) const {
+		auto const it = m_names.find(name);
+
+		if(it == m_names.end())
+			return NULL;
+
+		return &m_tensors[it->second];
+	}
+
+	// Pointer to the raw bits of a tensor
+	unsigned char const* data(TensorEntry const& entry) const {
+		return m_data + entry.offset;
+	}
+
+	// Decode a single tensor directly from the mapped file (with the same shape as in the file)
+	template <typename PositFile, typename T>
+	int read(std::string const& name, StdTensor<T>& tensor) const {
+		TensorEntry const* entry = find(name);
+
+		if(entry == NULL) {
+			std::cerr << "ERROR: tensor " << name << " not found in model file" << std::endl;
+			return -1;
+		}
+
+		if(entry->nbits!=PositFile::nbits || entry->es!=PositFile::es) {
+			std::cerr << "given: nbits=" << PositFile::nbits << " es=" << PositFile::es << std::endl;
+			std::cerr << "file (" << name << "): nbits=" << entry->nbits << " es=" << entry->es << std::endl;
+			throw std::invalid_argument( "posits have different sizes" );
+			return -1;
+		}
+
+		if(tensor.shape() != entry->shape) {
+			std::cerr << "given: shape=" << tensor.shape() << std::endl;
+			std::cerr << "file (" << name << "): shape=" << entry->shape << std::endl;
+			throw std::invalid_argument( "tensors have different shapes" );
+			return -1;
+		}
+
+		decode_posits<T, PositFile>(data(*entry), tensor.size(), tensor.vector().data());
+
+		return 0;
+	}
+
+private:
+	// Read a word from the file and advance position
+	bool read_word(size_t& position, size_t& word) const {
+		// Written so that nothing overflows, whatever the file says
+		if(position > m_size || sizeof(word) > m_size - position)
+			return false;
+
+		std::memcpy(&word, m_data+position, sizeof(word));
+		position += sizeof(word);
+
+		return true;
+	}
+
+	int read_index() {
+		size_t position = 0;
+		size_t magic, version, ntensors, index_offset, data_offset, alignment;
+
+		if(!read_word(position, magic) || magic != MODEL_FILE_MAGIC)
+			return -1;
+
+		if(!read_word(position, version) || version > MODEL_FILE_VERSION)
+			return -1;
+
+		if(	!read_word(position, ntensors) || !read_word(position, index_offset) ||
+			!read_word(position, data_offset) || !read_word(position, alignment)	)
+			return -1;
+
+		// Each entry of the index has at least 6 words (so a corrupt count doesn't allocate too much)
+		if(index_offset > m_size || ntensors > (m_size - index_offset) / (6*sizeof(size_t)))
+			return -1;
+
+		m_tensors.resize(ntensors);
+		position = index_offset;
+
+		for(size_t i=0; i<ntensors; i++) {
+			TensorEntry& entry = m_tensors[i];
+			size_t length, dim;
+
+			if(!read_word(position, length) || length > m_size - position)
+				return -1;
+
+			entry.name.assign((char const*)m_data+position, length);
+			position += length;
+
+			if(	!read_word(position, entry.nbits) || !read_word(position, entry.es) ||
+				!read_word(position, dim) || dim > (m_size - position) / sizeof(size_t)	)
+				return -1;
+
+			entry.shape.resize(dim);
+			for(size_t& s : entry.shape) {
+				if(!read_word(position, s))
+					return -1;
+			}
+
+			if(!read_word(position, entry.offset) || !read_word(position, entry.nbytes))
+				return -1;
+
+			// Check that data of tensor is inside the file
+			if(	entry.offset < data_offset || entry.offset > m_size ||
+				entry.nbytes > m_size - entry.offset	)
+				return -1;
+
+			// and that it has every entry of the shape (comparing with the entries that fit, so the product doesn't overflow)
+			size_t const bytes = entry.nbits/8 + ((entry.nbits%8 != 0) ? 1 : 0);
+			if(bytes == 0)
+				return -1;
+
+			size_t const max_size = entry.nbytes / bytes;
+			size_t size = 1;
+			for(size_t const s : entry.shape) {
+				if(s > 0 && size > max_size / s)
+					return -1;
+				size *= s;
+			}
+
+			m_names[entry.name] = i;
+		}
+
+		return 0;
+	}
+
+	MappedFile m_file;
+	unsigned char const* m_data = nullptr;
+	size_t m_size = 0;
+	std::vector<TensorEntry> m_tensors;
+	std::unordered_map<std::string, size_t> m_names;
+};
+
+// Write an indexed model file with the parameters and buffers of a model
+// Empty buffers (e.g. batch norms without running stats) aren't saved
+template <typename PositFile, typename Posit>
+int write_model_file(	std::vector<Parameter<Posit>>& parameters, std::vector<Buffer<Posit>>& buffers,
+						std::string const& filename	){
+
+	std::vector<std::pair<std::string, StdTensor<Posit> const*>> tensors;
+	tensors.reserve(parameters.size() + buffers.size());
+
+	for(Parameter<Posit> const& p : parameters)
+		tensors.emplace_back(p.name, &p.weight);
+
+	for(Buffer<Posit> const& b : buffers) {
+		if(!b.tensor.empty())
+			tensors.emplace_back(b.name, &b.tensor);
+	}
+
+	std::ofstream file;
+	file.open(filename, std::ios::out | std::ios::binary);
+
+	if(!file){
+		std::cout << "Error in creating file: " << filename;
+		return -1;
+	}
+
+	constexpr size_t nbytes = (PositFile::nbits+7)/8;
+	size_t const alignment = MODEL_FILE_ALIGNMENT;
+	auto const align = [alignment](size_t x){ return (x + alignment-1) / alignment * alignment; };
+
+	// Size of header and index
+	size_t const ntensors = tensors.size();
+	size_t const index_offset = 6*sizeof(size_t);
+	size_t index_size = 0;
+
+	for(auto const& t : tensors)
+		index_size += (6 + t.second->dim())*sizeof(size_t) + t.first.size();
+
+	// Offsets of data of each tensor
+	size_t const data_offset = align(index_offset + index_size);
+	std::vector<size_t> offsets(ntensors);
+
+	for(size_t i=0, offset=data_offset; i<ntensors; i++) {
+		offsets[i] = offset;
+		offset = align(offset + tensors[i].second->size()*nbytes);
+	}
+
+	// Header
+	size_t const header[] = {	MODEL_FILE_MAGIC, MODEL_FILE_VERSION, ntensors,
+								index_offset, data_offset, alignment	};
+	file.write((char*)header, sizeof(header));
+
+	// Index
+	for(size_t i=0; i<ntensors; i++) {
+		StdTensor<Posit> const& weight = *tensors[i].second;
+		std::string const& name = tensors[i].first;
+
+		size_t const length = name.size();
+		size_t const nbits = PositFile::nbits;
+		size_t const es = PositFile::es;
+		size_t const dim = weight.dim();
+		size_t const size = weight.size()*nbytes;
+
+		file.write((char*)&length, sizeof(length));
+		file.write(name.data(), length);
+		file.write((char*)&nbits, sizeof(nbits));
+		file.write((char*)&es, sizeof(es));
+		file.write((char*)&dim, sizeof(dim));
+		file.write((char*)weight.shape().data(), dim*sizeof(size_t));
+		file.write((char*)&offsets[i], sizeof(offsets[i]));
+		file.write((char*)&size, sizeof(size));
+	}
+
+	// Data (each block is aligned)
+	std::vector<unsigned char> buffer;
+	size_t position = index_offset + index_size;
+
+	for(size_t i=0; i<ntensors; i++) {
+		StdTensor<Posit> const& weight = *tensors[i].second;
+
+		buffer.assign(offsets[i]-position, 0);
+		file.write((char*)buffer.data(), buffer.size());
+
+		buffer.resize(weight.size()*nbytes);
+		encode_posits<Posit, PositFile>(weight.data(), weight.size(), buffer.data());
+		file.write((char*)buffer.data(), buffer.size());
+
+		position = offsets[i] + buffer.size();
+	}
+
+	file.close();
+
+	return 0;
+}
+
+// Write an indexed model file with only parameters
+template <typename PositFile, typename Posit>
+int write_model_file(std::vector<Parameter<Posit>>& parameters, std::string const& filename) {
+	std::vector<Buffer<Posit>> buffers;
+	return write_model_file<PositFile>(parameters, buffers, filename);
+}
+
+#endif /* MODELFILE_HPP */
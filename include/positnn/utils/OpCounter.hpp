@@ -0,0 +1,158 @@
+#ifndef OPCOUNTER_HPP
+#define OPCOUNTER_HPP
+
+#ifdef OP_COUNTER
+	#if OP_COUNTER>0
+		#define USING_OP_COUNTER
+	#endif
+#endif /* OP_COUNTER */
+
+// General headers
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <type_traits>
+#include <utility>
+#include <universal/posit/posit>
+
+// Number of posit operations executed (e.g. to cost out a hardware posit unit)
+// Enabled at compile time with OP_COUNTER=1; the macros below are empty otherwise
+//	COUNT_POSIT_OPS(op, n)			counts n operations (on posits)
+//	COUNT_OPS(T, op, n)				counts n operations if T is a posit
+//	COUNT_CONVERSIONS(From, To, n)	counts n conversions from/to posits
+#ifdef USING_OP_COUNTER
+	#define COUNT_POSIT_OPS(op, n)	OpCounter::count(op, n)
+	#define COUNT_OPS(T, op, n)	count_ops<T>(op, n)
+	#define COUNT_CONVERSIONS(From, To, n)	count_conversions<From, To>(n)
+#else
+	#define COUNT_POSIT_OPS(op, n)
+	#define COUNT_OPS(T, op, n)
+	#define COUNT_CONVERSIONS(From, To, n)
+#endif /* USING_OP_COUNTER */
+
+enum PositOp {
+	OP_ADD,				// additions and subtractions
+	OP_MUL,
+	OP_DIV,
+	OP_FUSED,			// fused multiply-add (fma, fam)
+	OP_QUIRE_MUL,		// products for the quire (MACs)
+	OP_QUIRE_ADD,		// sums for the quire
+	OP_QUIRE_ACC,		// accumulations into a quire
+	OP_QUIRE_OVERFLOW,	// accumulations that overflow a carry guard of nbits-2
+	OP_CONVERT,			// between posits, floats and quires
+	OP_EXP_LOG,			// exponentials, logarithms and square roots
+	N_POSIT_OPS
+};
+
+inline char const* op_name(size_t const op) {
+	static char const* const names[N_POSIT_OPS] = {	"add", "mul", "div", "fused", "q_mul",
+													"q_add", "q_acc", "q_overflow", "convert", "exp_log"	};
+	return names[op];
+}
+
+struct OpCounts {
+	uint64_t count[N_POSIT_OPS] = {};
+
+	OpCounts& operator+=(OpCounts const& other) {
+		for(size_t i=0; i<N_POSIT_OPS; i++)
+			count[i] += other.count[i];
+		return *this;
+	}
+
+	OpCounts operator-(OpCounts const& other) const {
+		OpCounts result;
+		for(size_t i=0; i<N_POSIT_OPS; i++)
+			result.count[i] = count[i] - other.count[i];
+		return result;
+	}
+};
+
+// Each thread has its own counters, so counting doesn't need locks
+// Counters of finished threads (e.g. of LL_THREADS) are added to the retired ones
+class OpCounter {
+public:
+	static void count(PositOp const op, uint64_t const n) {
+		std::atomic<uint64_t>& counter = local().count[op];
+		// Only this thread writes to it
+		counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+	}
+
+	// Operations of all threads since the beginning
+	static OpCounts total() {
+		Registry& r = registry();
+		std::lock_guard<std::mutex> lock(r.mutex);
+
+		OpCounts result = r.retired;
+		for(ThreadCounts const* counts : r.live)
+			result += counts->snapshot();
+
+		return result;
+	}
+
+private:
+	struct ThreadCounts;
+
+	struct Registry {
+		std::mutex mutex;
+		std::set<ThreadCounts const*> live;
+		OpCounts retired;
+	};
+
+	struct ThreadCounts {
+		std::atomic<uint64_t> count[N_POSIT_OPS];
+
+		ThreadCounts() {
+			for(size_t i=0; i<N_POSIT_OPS; i++)
+				count[i].store(0, std::memory_order_relaxed);
+
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.live.insert(this);
+		}
+
+		~ThreadCounts() {
+			Registry& r = registry();
+			std::lock_guard<std::mutex> lock(r.mutex);
+			r.retired += snapshot();
+			r.live.erase(this);
+		}
+
+		OpCounts snapshot() const {
+			OpCounts result;
+			for(size_t i=0; i<N_POSIT_OPS; i++)
+				result.count[i] = count[i].load(std::memory_order_relaxed);
+			return result;
+		}
+	};
+
+	static Registry& registry() {
+		static Registry r;
+		return r;
+	}
+
+	static ThreadCounts& local() {
+		thread_local ThreadCounts counts;
+		return counts;
+	}
+};
+
+template <typename T>
+struct is_posit : std::false_type {};
+
+template <size_t nbits, size_t es>
+struct is_posit<sw::unum::posit<nbits, es>> : std::true_type {};
+
+template <typename T>
+inline void count_ops(PositOp const op, uint64_t const n) {
+	if(is_posit<T>::value)
+		OpCounter::count(op, n);
+}
+
+template <typename From, typename To>
+inline void count_conversions(uint64_t const n) {
+	if(is_posit<From>::value || is_posit<To>::value)
+		OpCounter::count(OP_CONVERT, n);
+}
+
+#endif /* OPCOUNTER_HPP */
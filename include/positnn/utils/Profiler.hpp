@@ -0,0 +1,419 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#ifdef PROFILER
+	#if PROFILER>0
+		#define USING_PROFILER
+	#endif
+#endif /* PROFILER */
+
+// General headers
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Custom headers
+#include "../tensor/StdTensor.hpp"
+#include "OpCounter.hpp"
+
+// Layers are also named and scoped to count their operations (see OpCounter.hpp)
+#if defined(USING_PROFILER) || defined(USING_OP_COUNTER)
+	#define USING_PROFILE_SCOPES
+#endif
+
+// Time spent in forward, backward and gradient of each layer
+// Enabled at compile time with PROFILER=1 (or OP_COUNTER=1); the macros below are empty otherwise
+//	PROFILE_NAME(type)			type of the layer, e.g. "Conv2d"
+//	PROFILE_SCOPE(phase, input)	times the rest of the function
+//	PROFILE_OUTPUT(tensor)		counts the bytes of the returned tensor
+// Layers registered as modules are named by their type and path in the model (e.g. "Conv2d conv1"),
+// so copies of a model (e.g. built for each batch with HL_THREADS) share the same rows
+// Other layers (e.g. ReLU, MaxPool2d) share the row of their type
+// Each layer resolves the row of each phase once (see ProfileIds) and calls are counted per thread,
+// so scopes don't build names or take a global lock (only while tracing)
+#ifdef USING_PROFILE_SCOPES
+	#define PROFILE_NAME(type)	static char const* profile_type() { return type; } \
+								ProfileIds profile_ids;
+	#define PROFILE_SCOPE(phase, input)	ProfileScope profile_scope(profile_id(*this, this->profile_ids, this->profile_type(), phase), input)
+	#define PROFILE_SCOPE_NAMED(name, phase, input)	ProfileScope profile_scope(Profiler::instance().id(name, phase), input)
+	#define PROFILE_OUTPUT(tensor)	profile_scope.output(tensor)
+#else
+	#define PROFILE_NAME(type)
+	#define PROFILE_SCOPE(phase, input)
+	#define PROFILE_SCOPE_NAMED(name, phase, input)
+	#define PROFILE_OUTPUT(tensor)
+#endif /* USING_PROFILE_SCOPES */
+
+struct ProfileStats {
+	size_t calls = 0;
+	double seconds = 0;
+	size_t elements = 0;	// of the inputs
+	size_t bytes = 0;		// of the outputs
+	OpCounts ops;
+
+	ProfileStats& operator+=(ProfileStats const& other) {
+		calls += other.calls;
+		seconds += other.seconds;
+		elements += other.elements;
+		bytes += other.bytes;
+		ops += other.ops;
+		return *this;
+	}
+};
+
+// Rows of the phases of a layer, resolved on their first call
+// (and again if the path of the layer changes, e.g. when it is registered as a module)
+struct ProfileIds {
+	std::string path;
+	std::vector<std::pair<char const*, size_t>> ids;
+};
+
+class Profiler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	static Profiler& instance() {
+		static Profiler profiler;
+		return profiler;
+	}
+
+	// Row of (layer, phase), added in order of first call
+	size_t id(std::string const& name, char const* phase) {
+		std::lock_guard<std::mutex> lock(mutex);
+		return entry(name, phase);
+	}
+
+	void record(size_t const id, Clock::time_point const start, Clock::time_point const end,
+				size_t const elements, size_t const bytes, OpCounts const& ops) {
+
+		ThreadStats& local = thread_stats();
+
+		{
+			// Only contended while the stats are merged (see print)
+			std::lock_guard<std::mutex> lock(local.mutex);
+
+			if(id >= local.stats.size())
+				local.stats.resize(id+1);
+
+			ProfileStats& stats = local.stats[id];
+			stats.calls++;
+			stats.seconds += std::chrono::duration<double>(end-start).count();
+			stats.elements += elements;
+			stats.bytes += bytes;
+			stats.ops += ops;
+		}
+
+		if(tracing.load(std::memory_order_relaxed)) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if(events.size() < max_events)
+				events.push_back({id, local.index, start, end});
+		}
+	}
+
+	// Keep events (up to max) to be written with write_trace
+	void trace(bool const enable=true, size_t const max=1000000) {
+		std::lock_guard<std::mutex> lock(mutex);
+		tracing = enable;
+		max_events = max;
+		events.reserve(enable ? max_events : 0);
+	}
+
+	// Print tables with the stats since the last call (e.g. of an epoch)
+	void print(std::ostream& out=std::cout) {
+		std::lock_guard<std::mutex> lock(mutex);
+		(void)out;
+
+		merge_threads();
+
+#ifdef USING_PROFILER
+		print_time(out);
+#endif /* USING_PROFILER */
+
+#ifdef USING_OP_COUNTER
+		print_ops(out);
+#endif /* USING_OP_COUNTER */
+
+		// Start new epoch
+		epoch_stats.assign(entries.size(), ProfileStats());
+#ifdef USING_OP_COUNTER
+		epoch_ops = OpCounter::total();
+#endif /* USING_OP_COUNTER */
+	}
+
+	// Write events in Chrome trace format (open in chrome://tracing or Perfetto)
+	int write_trace(std::string const& filename) {
+		std::lock_guard<std::mutex> lock(mutex);
+
+		std::ofstream file(filename);
+
+		if(!file) {
+			std::cout << "Error in creating file: " << filename << std::endl;
+			return -1;
+		}
+
+		file << "{\"traceEvents\": [" << std::endl;
+
+		for(size_t i=0; i<events.size(); i++) {
+			Event const& e = events[i];
+			double const ts = std::chrono::duration<double, std::micro>(e.start-origin).count();
+			double const dur = std::chrono::duration<double, std::micro>(e.end-e.start).count();
+
+			file << "{\"name\": \"" << entries[e.id].first << "\", "
+				 << "\"cat\": \"" << entries[e.id].second << "\", "
+				 << "\"ph\": \"X\", \"ts\": " << std::fixed << ts << ", \"dur\": " << dur << ", "
+				 << "\"pid\": 0, \"tid\": " << e.thread << "}"
+				 << (i+1<events.size() ? "," : "") << std::endl;
+		}
+
+		file << "], \"displayTimeUnit\": \"ms\"}" << std::endl;
+
+		std::cout << "Saved to: " << filename << std::endl;
+
+		return 0;
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lock(mutex);
+		merge_threads();
+		epoch_stats.assign(entries.size(), ProfileStats());
+		events.clear();
+#ifdef USING_OP_COUNTER
+		epoch_ops = OpCounter::total();
+#endif /* USING_OP_COUNTER */
+	}
+
+private:
+	Profiler() :
+		origin(Clock::now())
+	{ }
+
+	struct Event {
+		size_t id;
+		size_t thread;
+		Clock::time_point start, end;
+	};
+
+	// Stats of the calls of a thread since they were last merged
+	// Merged again when the thread ends (e.g. the workers of HL_THREADS)
+	struct ThreadStats {
+		ThreadStats() {
+			Profiler& profiler = instance();
+			std::lock_guard<std::mutex> lock(profiler.mutex);
+			index = profiler.next_thread++;
+			profiler.threads.push_back(this);
+		}
+
+		~ThreadStats() {
+			Profiler& profiler = instance();
+			std::lock_guard<std::mutex> lock(profiler.mutex);
+			profiler.merge(*this);
+
+			for(size_t i=0; i<profiler.threads.size(); i++) {
+				if(profiler.threads[i] == this) {
+					profiler.threads.erase(profiler.threads.begin()+i);
+					break;
+				}
+			}
+		}
+
+		std::mutex mutex;
+		std::vector<ProfileStats> stats;
+		size_t index;	// small index of the thread, for the traces
+	};
+
+	static ThreadStats& thread_stats() {
+		static thread_local ThreadStats local;
+		return local;
+	}
+
+	// Add the stats of a thread to the epoch and reset them (with the lock of the profiler)
+	void merge(ThreadStats& local) {
+		std::lock_guard<std::mutex> lock(local.mutex);
+
+		for(size_t id=0; id<local.stats.size(); id++)
+			epoch_stats[id] += local.stats[id];
+
+		local.stats.clear();
+	}
+
+	void merge_threads() {
+		for(ThreadStats* local : threads)
+			merge(*local);
+	}
+
+	// Time of gradient is also included in backward
+	void print_time(std::ostream& out) const {
+		double total = 0;
+		for(size_t id=0; id<entries.size(); id++)
+			if(entries[id].second != "gradient")
+				total += epoch_stats[id].seconds;
+
+		char line[160];
+		std::snprintf(line, sizeof(line), "%-24s %-9s %8s %12s %7s %12s %10s %12s",
+						"Layer", "Phase", "Calls", "Time [ms]", "%", "Call [us]", "Elem [ns]", "Out [MB]");
+		out << line << std::endl;
+
+		for(size_t id=0; id<entries.size(); id++) {
+			ProfileStats const& s = epoch_stats[id];
+
+			if(s.calls == 0)
+				continue;
+
+			std::snprintf(line, sizeof(line), "%-24s %-9s %8zu %12.3f %7.2f %12.3f %10.3f %12.3f",
+							entries[id].first.c_str(), entries[id].second.c_str(), s.calls,
+							s.seconds*1e3, (total>0) ? 100*s.seconds/total : 0.,
+							s.seconds*1e6/s.calls, (s.elements>0) ? s.seconds*1e9/s.elements : 0.,
+							s.bytes/1e6);
+			out << line << std::endl;
+		}
+
+		std::snprintf(line, sizeof(line), "%-24s %-9s %8s %12.3f", "Total", "", "", total*1e3);
+		out << line << std::endl;
+	}
+
+#ifdef USING_OP_COUNTER
+	// Operations of each layer (exact only if layers don't run concurrently, i.e. HL_THREADS=1)
+	// Row "All" includes operations outside the layers (e.g. optimizer)
+	void print_ops(std::ostream& out) const {
+		char line[256];
+		int n = std::snprintf(line, sizeof(line), "%-24s %-9s", "Layer", "Phase");
+		for(size_t op=0; op<N_POSIT_OPS; op++)
+			n += std::snprintf(line+n, sizeof(line)-n, " %12s", op_name(op));
+		out << line << std::endl;
+
+		auto const print_row = [&out, &line](char const* name, char const* phase, OpCounts const& ops) {
+			int n = std::snprintf(line, sizeof(line), "%-24s %-9s", name, phase);
+			for(size_t op=0; op<N_POSIT_OPS; op++)
+				n += std::snprintf(line+n, sizeof(line)-n, " %12llu", static_cast<unsigned long long>(ops.count[op]));
+			out << line << std::endl;
+		};
+
+		for(size_t id=0; id<entries.size(); id++)
+			if(epoch_stats[id].calls > 0)
+				print_row(entries[id].first.c_str(), entries[id].second.c_str(), epoch_stats[id].ops);
+
+		OpCounts const all = OpCounter::total() - epoch_ops;
+		print_row("All", "", all);
+
+		uint64_t const accumulations = all.count[OP_QUIRE_ACC];
+#if QUIRE_MODE==2
+		uint64_t const overflows = all.count[OP_QUIRE_OVERFLOW];
+		out << "Quire accumulations that overflow a carry guard of nbits-2: " << overflows << " of " << accumulations;
+		if(accumulations > 0)
+			out << " (" << 100.0*overflows/accumulations << "%)";
+		out << std::endl;
+#else
+		// The quire of QUIRE_MODE=1 already has a carry guard of nbits-2
+		out << "Quire accumulations: " << accumulations << " (overflows of a carry guard of nbits-2 are only counted with QUIRE_MODE=2)" << std::endl;
+#endif /* QUIRE_MODE */
+	}
+#endif /* USING_OP_COUNTER */
+
+	// Index of (layer, phase)
+	size_t entry(std::string const& name, char const* phase) {
+		std::pair<std::string, std::string> key(name, phase);
+		auto const it = ids.find(key);
+
+		if(it != ids.end())
+			return it->second;
+
+		size_t const id = entries.size();
+		ids[key] = id;
+		entries.push_back(key);
+		epoch_stats.push_back(ProfileStats());
+
+		return id;
+	}
+
+	std::mutex mutex;
+	Clock::time_point const origin;
+	std::map<std::pair<std::string, std::string>, size_t> ids;
+	std::vector<std::pair<std::string, std::string>> entries;	// in order of first call
+	std::vector<ProfileStats> epoch_stats;
+	OpCounts epoch_ops;
+	std::vector<ThreadStats*> threads;
+	size_t next_thread = 0;
+	std::atomic<bool> tracing{false};
+	size_t max_events = 0;
+	std::vector<Event> events;
+};
+
+// Path of a layer in the model if it is a registered module (see Layer)
+template <typename L>
+auto profile_path(L const& layer, int) -> decltype(layer.module_path()) {
+	return layer.module_path();
+}
+
+template <typename L>
+std::string const& profile_path(L const&, long) {
+	static std::string const empty;
+	return empty;
+}
+
+// Row of a phase of a layer: its type, followed by its path if it is a registered module
+// Only the first call of each phase (or after the path changes) builds the name
+template <typename L>
+size_t profile_id(L const& layer, ProfileIds& cache, char const* type, char const* phase) {
+	std::string const& path = profile_path(layer, 0);
+
+	if(path != cache.path) {
+		cache.path = path;
+		cache.ids.clear();
+	}
+
+	for(std::pair<char const*, size_t> const& id : cache.ids)
+		if(id.first == phase || std::strcmp(id.first, phase) == 0)
+			return id.second;
+
+	size_t const id = Profiler::instance().id((path.empty()) ? std::string(type) : std::string(type) + " " + path, phase);
+	cache.ids.emplace_back(phase, id);
+
+	return id;
+}
+
+// Times a call from its construction to its destruction
+class ProfileScope {
+public:
+	template <typename T>
+	ProfileScope(size_t const _id, StdTensor<T> const& input) :
+		id(_id),
+		elements(input.size()),
+#ifdef USING_OP_COUNTER
+		ops(OpCounter::total()),
+#endif /* USING_OP_COUNTER */
+		start(Profiler::Clock::now())
+	{ }
+
+	~ProfileScope() {
+		Profiler::Clock::time_point const end = Profiler::Clock::now();
+#ifdef USING_OP_COUNTER
+		Profiler::instance().record(id, start, end, elements, bytes, OpCounter::total() - ops);
+#else
+		Profiler::instance().record(id, start, end, elements, bytes, OpCounts());
+#endif /* USING_OP_COUNTER */
+	}
+
+	template <typename T>
+	void output(StdTensor<T> const& y) {
+		bytes += y.size() * sizeof(T);
+	}
+
+private:
+	size_t const id;
+	size_t const elements;
+	size_t bytes = 0;
+#ifdef USING_OP_COUNTER
+	OpCounts const ops;		// of all threads at the start
+#endif /* USING_OP_COUNTER */
+	Profiler::Clock::time_point const start;
+};
+
+#endif /* PROFILER_HPP */
@@ -6,19 +6,79 @@
 // General headers
 #include <universal/posit/posit>
 
+// Custom headers
+#include "OpCounter.hpp"
+
+#if defined(USING_OP_COUNTER) && defined(QUIRE_MODE) && QUIRE_MODE>0
+// Quire that counts its accumulations and, with QUIRE_MODE=2, how many of them would overflow
+// a quire with a carry guard of nbits-2 (QUIRE_MODE=1)
+// With QUIRE_MODE=1 the quire already has that carry guard, so overflows aren't counted
+template <size_t nbits, size_t es, size_t capacity>
+class CountedQuire : public sw::unum::quire<nbits, es, capacity> {
+public:
+	using Base = sw::unum::quire<nbits, es, capacity>;
+	using Base::Base;
+
+	// Largest scale that fits in the integer part of the quire plus the carry guard
+	static constexpr int max_scale_narrow = (1 << es) * (2*nbits - 4) + (nbits - 2);
+
+	template <typename T>
+	CountedQuire& operator=(T const& rhs) {
+		Base::operator=(rhs);
+		return *this;
+	}
+
+	template <typename T>
+	CountedQuire& operator+=(T const& rhs) {
+		Base::operator+=(rhs);
+		count_accumulation();
+		return *this;
+	}
+
+	template <typename T>
+	CountedQuire& operator-=(T const& rhs) {
+		Base::operator-=(rhs);
+		count_accumulation();
+		return *this;
+	}
+
+	auto to_value() const -> decltype(std::declval<Base const&>().to_value()) {
+		COUNT_POSIT_OPS(OP_CONVERT, 1);
+		return Base::to_value();
+	}
+
+private:
+	void count_accumulation() const {
+		COUNT_POSIT_OPS(OP_QUIRE_ACC, 1);
+
+#if QUIRE_MODE==2
+		auto const sum = Base::to_value();
+		if(!sum.iszero() && sum.scale() > max_scale_narrow)
+			COUNT_POSIT_OPS(OP_QUIRE_OVERFLOW, 1);
+#endif /* QUIRE_MODE */
+	}
+};
+
+template <size_t nbits, size_t es, size_t capacity>
+using QuireType = CountedQuire<nbits, es, capacity>;
+#else
+template <size_t nbits, size_t es, size_t capacity>
+using QuireType = sw::unum::quire<nbits, es, capacity>;
+#endif /* USING_OP_COUNTER */
+
 // old standard
 // using carry guard size = nbits-1
 #if QUIRE_MODE==1
 
 template <size_t nbits, size_t es>
-using Quire = sw::unum::quire<nbits, es, nbits-2>;
+using Quire = QuireType<nbits, es, nbits-2>;
 
 // new standard
 // using carry guard size = 31
 #elif QUIRE_MODE==2
 
 template <size_t nbits, size_t es>
-using Quire = sw::unum::quire<nbits, es, 30>;
+using Quire = QuireType<nbits, es, 30>;
 
 // not using quires
 #else
@@ -33,11 +93,13 @@ using Quire = sw::unum::posit<nbits, es>;
 
 template<size_t nbits, size_t es>
 inline posit<nbits, es> Quire_add(const posit<nbits, es>& lhs, const posit<nbits, es>& rhs) {
+	COUNT_POSIT_OPS(OP_QUIRE_ADD, 1);
 	return lhs+rhs;
 }
 
 template<size_t nbits, size_t es>
 inline posit<nbits, es> Quire_mul(const posit<nbits, es>& lhs, const posit<nbits, es>& rhs) {
+	COUNT_POSIT_OPS(OP_QUIRE_MUL, 1);
 	return lhs*rhs;
 }
 
@@ -46,11 +108,13 @@ inline posit<nbits, es> Quire_mul(const posit<nbits, es>& lhs, const posit<nbits
 
 template<size_t nbits, size_t es>
 inline value<nbits - es + 2> Quire_add(const posit<nbits, es>& lhs, const posit<nbits, es>& rhs) {
+	COUNT_POSIT_OPS(OP_QUIRE_ADD, 1);
 	return quire_add(lhs, rhs);
 }
 
 template<size_t nbits, size_t es>
 inline value<2 * (nbits - 2 - es)> Quire_mul(const posit<nbits, es>& lhs, const posit<nbits, es>& rhs) {
+	COUNT_POSIT_OPS(OP_QUIRE_MUL, 1);
 	return quire_mul(lhs, rhs);
 }
 
@@ -0,0 +1,348 @@
+#ifndef TEXTDATAREADER_HPP
+#define TEXTDATAREADER_HPP
+
+#ifdef LL_THREADS
+	#if LL_THREADS>1
+		#define USING_LL_THREADS
+	#endif
+#endif /* LL_THREADS */
+
+// General headers
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#ifdef USING_LL_THREADS
+#include <thread>
+#endif /* USING_LL_THREADS */
+#include <vector>
+
+// Custom headers
+#include "../tensor/StdTensor.hpp"
+#include "MappedFile.hpp"
+
+// Values are separated by spaces, tabs, commas or semicolons
+inline bool is_separator(char const c) {
+	return c==' ' || c==',' || c=='\t' || c==';' || c=='\r';
+}
+
+// Parse a decimal number at the beginning of [begin, end), like std::from_chars
+// (not available in C++14) and unlike std::stof it doesn't need a null terminator
+// Returns pointer to the character after the number (begin if there is none)
+inline char const* parse_float(char const* const begin, char const* const end, float& value) {
+	static double const powers[] = {	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+										1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19,
+										1e20, 1e21, 1e22	};
+	size_t const max_power = sizeof(powers)/sizeof(powers[0]) - 1;
+	size_t const max_digits = 19;	// fit in 64 bits
+
+	char const* p = begin;
+	bool const negative = (p<end && *p=='-');
+	if(p<end && (*p=='-' || *p=='+'))
+		p++;
+
+	// Special values
+	auto const match = [&p, end](char const* word) {
+		size_t const length = std::strlen(word);
+		if(static_cast<size_t>(end-p) < length)
+			return false;
+		for(size_t i=0; i<length; i++)
+			if((p[i] | 0x20) != word[i])	// lower case
+				return false;
+		p += length;
+		return true;
+	};
+
+	if(p<end && ((*p|0x20)=='n' || (*p|0x20)=='i')) {
+		if(match("nan"))
+			value = std::numeric_limits<float>::quiet_NaN();
+		else if(match("infinity") || match("inf"))
+			value = negative ? -std::numeric_limits<float>::infinity() : std::numeric_limits<float>::infinity();
+		else
+			return begin;
+		return p;
+	}
+
+	// Significand (digits that don't fit are only counted in the exponent)
+	uint64_t significand = 0;
+	long exponent = 0;
+	size_t digits = 0;
+	bool any_digit = false;
+
+	for(; p<end && *p>='0' && *p<='9'; p++) {
+		any_digit = true;
+		if(digits < max_digits) {
+			significand = significand*10 + (*p-'0');
+			digits += (significand>0);
+		}
+		else
+			exponent++;
+	}
+
+	if(p<end && *p=='.') {
+		p++;
+		for(; p<end && *p>='0' && *p<='9'; p++) {
+			any_digit = true;
+			if(digits < max_digits) {
+				significand = significand*10 + (*p-'0');
+				digits += (significand>0);
+				exponent--;
+			}
+		}
+	}
+
+	if(!any_digit)
+		return begin;
+
+	// Exponent (only consumed if it has digits)
+	if(p<end && (*p|0x20)=='e') {
+		char const* q = p+1;
+		bool const negative_exponent = (q<end && *q=='-');
+		if(q<end && (*q=='-' || *q=='+'))
+			q++;
+
+		if(q<end && *q>='0' && *q<='9') {
+			long e = 0;
+			for(; q<end && *q>='0' && *q<='9'; q++)
+				if(e < 100000)
+					e = e*10 + (*q-'0');
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+
+	double x = static_cast<double>(significand);
+	if(exponent != 0 && significand != 0) {
+		size_t const magnitude = (exponent<0) ? -exponent : exponent;
+		double const scale = (magnitude<=max_power) ? powers[magnitude] : std::pow(10.0, magnitude);
+		x = (exponent<0) ? x/scale : x*scale;
+	}
+
+	value = static_cast<float>(negative ? -x : x);
+	return p;
+}
+
+// Parse rows of [first, last) with the given number of columns
+// Returns index of the first invalid row (number of rows if they are all valid)
+template <typename T>
+size_t parse_rows(	char const* data,
+					std::vector<size_t> const& begins,
+					std::vector<size_t> const& ends,
+					size_t const first, size_t const last,
+					size_t const columns, T* output	){
+
+	float value;
+
+	for(size_t i=first; i<last; i++) {
+		char const* p = data + begins[i];
+		char const* const end = data + ends[i];
+
+		for(size_t j=0; j<columns; j++) {
+			while(p<end && is_separator(*p))
+				p++;
+
+			char const* const next = parse_float(p, end, value);
+
+			// Missing or invalid value
+			if(next == p)
+				return i;
+
+			output[i*columns + j] = T(value);
+			p = next;
+		}
+
+		while(p<end && is_separator(*p))
+			p++;
+
+		// Too many values
+		if(p != end)
+			return i;
+	}
+
+	return begins.size();
+}
+
+#ifdef USING_LL_THREADS
+template <typename T>
+void parse_rows_thread(	char const* data,
+						std::vector<size_t> const& begins,
+						std::vector<size_t> const& ends,
+						size_t const first, size_t const last,
+						size_t const columns, T* output,
+						size_t& invalid	){
+
+	invalid = parse_rows(data, begins, ends, first, last, columns, output);
+}
+#endif /* USING_LL_THREADS */
+
+// Reads samples from a text file (one per line) mapped to memory
+// The file can be read at once or in chunks of rows, which allows
+// streaming files larger than the memory
+class TextDataReader {
+public:
+	TextDataReader() { }
+
+	TextDataReader(std::string const& filename) {
+		open(filename);
+	}
+
+	// Map file and count the values in its first line
+	int open(std::string const& filename) {
+		m_columns = 0;
+		m_position = 0;
+		m_line = 0;
+
+		if(m_file.open(filename, true) != 0)
+			return -1;
+
+		size_t begin, end;
+		size_t position = 0;
+		bool const empty = !next_line(position, begin, end);
+		m_line = 0;
+
+		if(empty)
+			return 0;
+
+		float value;
+		char const* p = m_file.data() + begin;
+		char const* const line_end = m_file.data() + end;
+
+		while(true) {
+			while(p<line_end && is_separator(*p))
+				p++;
+
+			char const* const next = parse_float(p, line_end, value);
+			if(next == p)
+				break;
+
+			m_columns++;
+			p = next;
+		}
+
+		return 0;
+	}
+
+	// Number of values per row
+	size_t columns() const {
+		return m_columns;
+	}
+
+	// No more rows to read
+	bool eof() const {
+		return m_position >= m_file.size();
+	}
+
+	void rewind() {
+		m_position = 0;
+		m_line = 0;
+	}
+
+	// Read the next rows (every remaining row if max_rows=0) into a tensor
+	// with shape {rows, columns}
+	// Returns the number of rows read
+	template <typename T>
+	size_t read(StdTensor<T>& tensor, size_t const max_rows=0) {
+		// Find rows (not empty lines) of this chunk
+		size_t const chunk_begin = m_position;
+		std::vector<size_t> begins, ends, lines;
+		size_t begin, end;
+
+		while((max_rows==0 || begins.size()<max_rows) && next_line(m_position, begin, end)) {
+			begins.push_back(begin);
+			ends.push_back(end);
+			lines.push_back(m_line);
+		}
+
+		size_t const rows = begins.size();
+		tensor = StdTensor<T>({rows, m_columns});
+
+		if(rows == 0)
+			return 0;
+
+		T* output = tensor.vector().data();
+		size_t invalid = rows;
+
+#ifndef USING_LL_THREADS
+		invalid = parse_rows(m_file.data(), begins, ends, 0, rows, m_columns, output);
+#else
+		size_t const max_threads = (LL_THREADS<rows) ? LL_THREADS : rows;
+		std::vector<std::thread> threads;
+		threads.reserve(max_threads);
+		std::vector<size_t> invalid_rows(max_threads, rows);
+
+		size_t const nrows = rows / max_threads;
+		size_t const nthreads_more = rows % max_threads;
+		size_t first, last=0;
+
+		for(size_t t=0; t<max_threads; t++) {
+			first = last;
+
+			if(t < nthreads_more)
+				last += nrows+1;
+			else
+				last += nrows;
+
+			threads.push_back(std::thread(parse_rows_thread<T>,
+											m_file.data(), std::cref(begins), std::cref(ends),
+											first, last, m_columns, output,
+											std::ref(invalid_rows[t])));
+		}
+
+		for(size_t t=0; t<max_threads; t++) {
+			threads[t].join();
+
+			if(invalid_rows[t] < invalid)
+				invalid = invalid_rows[t];
+		}
+#endif /* USING_LL_THREADS */
+
+		// Parsed data is no longer needed in memory
+		if(max_rows > 0)
+			m_file.release(chunk_begin, m_position);
+
+		if(invalid < rows) {
+			std::cerr << "ERROR: line " << lines[invalid] << " doesn't have " << m_columns << " values" << std::endl;
+			throw std::invalid_argument( "invalid row in data file" );
+		}
+
+		return rows;
+	}
+
+private:
+	// Get next line with values, starting at position
+	// Updates position to the start of the following line
+	bool next_line(size_t& position, size_t& begin, size_t& end) {
+		char const* const data = m_file.data();
+		size_t const size = m_file.size();
+
+		while(position < size) {
+			begin = position;
+
+			void const* newline = std::memchr(data+position, '\n', size-position);
+			end = (newline == NULL) ? size : static_cast<char const*>(newline) - data;
+			position = end + 1;
+			m_line++;
+
+			// Skip empty lines
+			size_t i = begin;
+			while(i<end && is_separator(data[i]))
+				i++;
+
+			if(i < end)
+				return true;
+		}
+
+		position = size;
+		return false;
+	}
+
+	MappedFile m_file;
+	size_t m_columns = 0;
+	size_t m_position = 0;	// start of the next line to read
+	size_t m_line = 0;		// number of lines already read (including empty ones)
+};
+
+#endif /* TEXTDATAREADER_HPP */
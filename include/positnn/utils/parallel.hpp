@@ -0,0 +1,40 @@
+#ifndef PARALLEL_HPP
+#define PARALLEL_HPP
+
+#ifdef LL_THREADS
+	#if LL_THREADS>1
+		#define USING_LL_THREADS
+	#endif
+#endif /* LL_THREADS */
+
+// General headers
+#include <cstddef>
+#ifdef USING_LL_THREADS
+#include <thread>
+#endif /* USING_LL_THREADS */
+#include <utility>
+#include <vector>
+
+// Distribute units of work between threads, each one taking a contiguous range of the same # of units
+// f is called as f(args..., unit_begin, unit_end), so arguments passed by reference need std::ref/std::cref
+// Without LL_THREADS, f is called once with all the units
+template <typename Function, typename... Args>
+void parallel_units(size_t const units, Function f, Args&&... args) {
+#ifndef USING_LL_THREADS
+	f(std::forward<Args>(args)..., 0, units);
+#else
+	size_t const max_threads = (LL_THREADS<units) ? LL_THREADS : ((units>0) ? units : 1);
+	std::vector<std::thread> threads;
+	threads.reserve(max_threads);
+
+	for(size_t t=0; t<max_threads; t++){
+		threads.push_back(std::thread(f, args..., t*units/max_threads, (t+1)*units/max_threads));
+	}
+
+	for(std::thread& t : threads) {
+		t.join();
+	}
+#endif /* USING_LL_THREADS */
+}
+
+#endif /* PARALLEL_HPP */
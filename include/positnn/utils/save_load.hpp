@@ -7,7 +7,24 @@
 #include <fstream>
 #include <iostream>
 
-//#include "Net.hpp"
+// Custom headers
+#include "ModelFile.hpp"
+#include "utils.hpp"
+
+// First word of files with a header (legacy files start with nbits)
+constexpr size_t POSIT_FILE_MAGIC = 0x54495350464e4e50;	// "PNNFPSIT"
+
+template <typename PositFile>
+void write_header(std::ostream& out) {
+	size_t const magic = POSIT_FILE_MAGIC;
+	size_t const version = POSIT_FILE_VERSION;
+	size_t const nbits = PositFile::nbits;
+	size_t const es = PositFile::es;
+	out.write((char*)&magic, sizeof(magic));
+	out.write((char*)&version, sizeof(version));
+	out.write((char*)&nbits, sizeof(nbits));
+	out.write((char*)&es, sizeof(es));
+}
 
 template <typename PositFile, typename T, typename String>
 int save(T& object, String filename) {
@@ -19,11 +36,7 @@ int save(T& object, String filename) {
 		return -1;
 	}
 
-	size_t const nbits = PositFile::nbits;
-	size_t const es = PositFile::es;
-	file.write((char*)&nbits, sizeof(nbits));
-	file.write((char*)&es, sizeof(es));
-
+	write_header<PositFile>(file);
 	object.template write<PositFile>(file);
 
 	std::cout << "Saved to: " << filename << std::endl;
@@ -41,10 +54,24 @@ int load(T& object, String filename) {
 		return -1;
 	}
 	
+	size_t version = 1;
 	size_t nbits;
 	size_t es;
 	file.read((char*)&nbits, sizeof(nbits));
+
+	// Files with header have magic and version before nbits
+	if(nbits == POSIT_FILE_MAGIC) {
+		file.read((char*)&version, sizeof(version));
+		file.read((char*)&nbits, sizeof(nbits));
+	}
+
 	file.read((char*)&es, sizeof(es));
+
+	if (version > POSIT_FILE_VERSION) {
+		std::cerr << "file version " << version << " is newer than supported (" << POSIT_FILE_VERSION << ")" << std::endl;
+		throw std::invalid_argument( "unsupported file version" );
+		return -1;
+	}
 	
 	if (nbits!=PositFile::nbits || es!=PositFile::es) {
 		std::cerr << "given: nbits=" << PositFile::nbits << " es=" << PositFile::es << std::endl;
@@ -53,7 +80,7 @@ int load(T& object, String filename) {
 		return -1;
 	}
 
-	object.template read<PositFile>(file);
+	object.template read<PositFile>(file, version);
 
 	std::cout << "Loaded from: " << filename << std::endl;
 	
@@ -61,4 +88,30 @@ int load(T& object, String filename) {
 	return 0;
 }
 
+// Save parameters and buffers to an indexed file that can be mapped to memory (see ModelFile)
+template <typename PositFile, typename T, typename String>
+int save_mapped(T& object, String filename) {
+	if(write_model_file<PositFile>(object.parameters(), object.buffers(), filename) != 0)
+		return -1;
+
+	std::cout << "Saved to: " << filename << std::endl;
+
+	return 0;
+}
+
+// Load parameters and buffers by name from an indexed file mapped to memory
+template <typename PositFile, typename T, typename String>
+int load_mapped(T& object, String filename) {
+	ModelFile file;
+
+	if(file.open(filename) != 0)
+		return -1;
+
+	object.template read<PositFile>(file);
+
+	std::cout << "Loaded from: " << filename << std::endl;
+
+	return 0;
+}
+
 #endif /* SAVE_LOAD_HPP */
@@ -16,6 +16,7 @@
 
 // Custom headers
 #include "../tensor/StdTensor.hpp"
+#include "GradMode.hpp"
 #include "Quire.hpp"
 
 template <typename Loss, typename T, template<typename> class Model, typename Target>
@@ -24,7 +25,10 @@ void batch_worker(	Model<T>& master_model,
 					StdTensor<Target> const& batch_target,
 					size_t const batch_begin, size_t const batch_end,
 					std::vector<StdTensor<typename T::Optimizer>>& gradients,
-					float& loss_value	){
+					float& loss_value, bool const grad	){
+
+	// GradMode of the thread that started this one
+	AutoGradMode grad_mode(grad);
 
 	// Local model
 	Model<T> model;
@@ -97,7 +101,7 @@ void forward_backward(	Model<T>& model,
 										std::cref(data), std::cref(target),
 										batch_begin, batch_end,
 										std::ref(gradients[t]),
-										std::ref(losses[t])));
+										std::ref(losses[t]), GradMode::is_enabled()));
 	}
 
 	for(std::thread& t : workers_threads)
@@ -192,7 +196,10 @@ void forward_worker(	Model<T>& master_model,
 						StdTensor<Target> const& batch_target,
 						StdTensor<Target>& pred,
 						size_t const batch_begin, size_t const batch_end,
-						float& loss_value	){
+						float& loss_value, bool const grad	){
+
+	// GradMode of the thread that started this one
+	AutoGradMode grad_mode(grad);
 
 	// Local model
 	Model<T> model;
@@ -228,6 +235,9 @@ StdTensor<Target> forward(	Model<T>& model,
 							StdTensor<Target> target,
 							std::vector<float>& losses	){
 	
+	// Only inference, so layers don't keep what backward needs
+	NoGradGuard no_grad;
+
 	// Batch size
 	size_t const batch_size = target.shape()[0];
 
@@ -260,7 +270,7 @@ StdTensor<Target> forward(	Model<T>& model,
 										std::cref(data), std::cref(target),
 										std::ref(pred),
 										batch_begin, batch_end,
-										std::ref(losses[t])	));
+										std::ref(losses[t]), GradMode::is_enabled()	));
 	}
 
 	for(std::thread& t : workers_threads)
@@ -104,27 +104,119 @@ void read_posit(std::istream& in, Posit& p){
 	p = aux;
 }
 
-// TODO: save posit nbits and es
+// Version of the format used to save posits to a file
+// 1 - posits written bit by bit, one byte per write (legacy, files without header)
+// 2 - raw bits of each posit packed in little-endian bytes, one write per vector
+// 3 - models also save the buffers of their modules (e.g. running stats of batch norms)
+constexpr size_t POSIT_FILE_VERSION = 3;
+
+// Encode posits to a buffer with the raw bits of each one (little-endian)
+template <typename Posit, typename PositFile>
+void encode_posits(Posit const* from, size_t const n, unsigned char* to){
+	constexpr size_t nbits = PositFile::nbits;
+	constexpr size_t nbytes = (nbits+7)/8;
+	static_assert(nbits<=64, "posits with more than 64 bits cannot be encoded");
+
+	for(size_t i=0; i<n; i++){
+		PositFile const aux = from[i];
+		unsigned long long raw = aux.get().to_ullong();
+
+		for(size_t b=0; b<nbytes; b++){
+			*to++ = static_cast<unsigned char>(raw & 0xFF);
+			raw >>= 8;
+		}
+	}
+}
+
+// Decode posits from a buffer with the raw bits of each one (little-endian)
+template <typename Posit, typename PositFile>
+void decode_posits(unsigned char const* from, size_t const n, Posit* to){
+	constexpr size_t nbits = PositFile::nbits;
+	constexpr size_t nbytes = (nbits+7)/8;
+	static_assert(nbits<=64, "posits with more than 64 bits cannot be decoded");
+
+	PositFile aux;
+
+	for(size_t i=0; i<n; i++){
+		unsigned long long raw = 0;
+
+		for(size_t b=nbytes; b-->0; ){
+			raw <<= 8;
+			raw |= from[b];
+		}
+		from += nbytes;
+
+		aux.set_raw_bits(raw);
+		to[i] = aux;
+	}
+}
 
 template <typename Posit, typename PositFile>
 void write_vector_posit(std::ostream& out, const std::vector<Posit>& vec) {
+	constexpr size_t nbytes = (PositFile::nbits+7)/8;
+
 	size_t const size = vec.size();
 	out.write((char*)&size, sizeof(size));
 
-	for(Posit const& elem : vec) {
-		write_posit<Posit, PositFile>(out, elem);
-	}
+	// Encode everything first and then write it at once
+	std::vector<unsigned char> buffer(size*nbytes);
+	encode_posits<Posit, PositFile>(vec.data(), size, buffer.data());
+	out.write((char*)buffer.data(), buffer.size());
 }
 
 template <typename Posit, typename PositFile>
-void read_vector_posit(std::istream& in, std::vector<Posit>& vec) {
+void read_vector_posit(std::istream& in, std::vector<Posit>& vec, size_t const version=POSIT_FILE_VERSION) {
+	constexpr size_t nbytes = (PositFile::nbits+7)/8;
+
 	size_t size;
 	in.read((char*)&size, sizeof(size));
 	vec.resize(size);
 
-	for(size_t i=0; i<size; i++){
-		read_posit<Posit, PositFile>(in, vec[i]);
+	// Legacy files
+	if(version < 2) {
+		for(size_t i=0; i<size; i++){
+			read_posit<Posit, PositFile>(in, vec[i]);
+		}
+		return;
 	}
+
+	// Read everything at once and then decode it
+	std::vector<unsigned char> buffer(size*nbytes);
+	in.read((char*)buffer.data(), buffer.size());
+	decode_posits<Posit, PositFile>(buffer.data(), size, vec.data());
+}
+
+// Posits are ordered like the two's complement integers of their bits (NaR is the smallest),
+// so they can be compared as integers instead of with the comparison operators of posit
+template <size_t nbits, size_t es>
+inline int64_t posit_ordinal(posit<nbits, es> const& p) {
+	static_assert(nbits <= 64, "posit_ordinal: posit has more than 64 bits");
+	return static_cast<int64_t>(uint64_t(p.get().to_ullong()) << (64-nbits)) >> (64-nbits);
+}
+
+// a < b (through posit_ordinal for posits)
+template <typename T>
+inline bool ordinal_less(T const& a, T const& b) {
+	return a < b;
+}
+
+template <size_t nbits, size_t es>
+inline bool ordinal_less(posit<nbits, es> const& a, posit<nbits, es> const& b) {
+	return posit_ordinal(a) < posit_ordinal(b);
+}
+
+// Comparator for std::max_element, std::sort, etc.
+struct OrdinalLess {
+	template <typename T>
+	bool operator()(T const& a, T const& b) const {
+		return ordinal_less(a, b);
+	}
+};
+
+// Same as p.isneg() || p.iszero() (i.e. true for zero, negatives and NaR)
+template <size_t nbits, size_t es>
+inline bool is_nonpositive(posit<nbits, es> const& p) {
+	return posit_ordinal(p) <= 0;
 }
 
 template <size_t nbits, size_t es>